@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Shared helpers for the benchmark programs. Each program runs a fixed
+// workload and prints one line per measurement, so runs can be diffed.
+namespace Bench {
+
+class Stopwatch {
+public:
+    Stopwatch() : m_start(std::chrono::steady_clock::now()) {}
+
+    void Restart() { m_start = std::chrono::steady_clock::now(); }
+
+    double Seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+    double Micros() const { return Seconds() * 1e6; }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Deterministic generator so every run sees the same workload
+class Random {
+public:
+    explicit Random(uint64_t seed) : m_state(seed) {}
+
+    uint64_t Next() {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    size_t Below(size_t limit) { return static_cast<size_t>(Next() % limit); }
+
+private:
+    uint64_t m_state;
+};
+
+// Clipboard-like text: mostly a line or two, sometimes a pasted block
+inline std::string MakeText(Random& random, size_t index) {
+    static const char* const kWords[] = {
+        "clipboard", "history", "return", "value", "https://example.com/path",
+        "const", "error", "meeting", "notes", "the", "and", "select", "from",
+        "where", "std::string", "password", "TODO", "build", "release", "fix"
+    };
+    const size_t wordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+    size_t words = random.Below(8) == 0 ? 200 + random.Below(400) : 2 + random.Below(14);
+    std::string text = std::to_string(index);
+    for (size_t i = 0; i < words; i++) {
+        text.push_back(i % 12 == 11 ? '\n' : ' ');
+        text.append(kWords[random.Below(wordCount)]);
+    }
+    return text;
+}
+
+// Sorts samples in place and prints p50/p99/max in microseconds
+inline void PrintLatency(const char* label, std::vector<double>& micros) {
+    if (micros.empty()) {
+        return;
+    }
+    std::sort(micros.begin(), micros.end());
+    auto at = [&](double q) { return micros[static_cast<size_t>(q * (micros.size() - 1))]; };
+    std::printf("%-32s p50 %8.2f us  p99 %8.2f us  max %9.2f us\n", label, at(0.50), at(0.99), micros.back());
+}
+
+inline void PrintRate(const char* label, double count, double seconds, const char* unit) {
+    std::printf("%-32s %12.0f %s/s  (%.3f s)\n", label, seconds > 0 ? count / seconds : 0.0, unit, seconds);
+}
+
+// First argument overrides the workload size
+inline size_t SizeArg(int argc, char** argv, size_t fallback) {
+    if (argc > 1) {
+        size_t value = static_cast<size_t>(std::strtoull(argv[1], nullptr, 10));
+        if (value > 0) {
+            return value;
+        }
+    }
+    return fallback;
+}
+
+} // namespace Bench
@@ -0,0 +1,142 @@
+// Ratio and speed of the LZ4 codec on clipboard-sized payloads: this
+// repository's own sources, generated logs and JSON, and short text.
+// Usage: compression_bench [rounds]
+#include "BenchCommon.h"
+#include "Compression.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+struct Corpus {
+    const char* name;
+    std::vector<std::string> entries;
+};
+
+std::vector<std::string> LoadSources() {
+    std::vector<std::string> entries;
+#ifdef CLIPPY2000_SOURCE_DIR
+    std::error_code ec;
+    for (const char* dir : { "src", "include" }) {
+        std::filesystem::path root = std::filesystem::path(CLIPPY2000_SOURCE_DIR) / dir;
+        for (const auto& item : std::filesystem::directory_iterator(root, ec)) {
+            std::ifstream file(item.path(), std::ios::binary);
+            entries.emplace_back((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        }
+    }
+#endif
+    return entries;
+}
+
+std::vector<std::string> MakeLogs(Bench::Random& random) {
+    static const char* const kLevels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char* const kMessages[] = {
+        "request completed", "cache miss for key", "retrying connection to", "user signed in",
+        "slow query took", "queue depth is", "failed to parse header from"
+    };
+    std::vector<std::string> entries;
+    for (int i = 0; i < 200; i++) {
+        std::string log;
+        size_t lines = 50 + random.Below(400);
+        for (size_t line = 0; line < lines; line++) {
+            log += "2024-05-01T12:" + std::to_string(10 + random.Below(50)) + ":" + std::to_string(10 + random.Below(50)) +
+                   "." + std::to_string(random.Below(1000)) + " [" + kLevels[random.Below(4)] + "] worker-" +
+                   std::to_string(random.Below(16)) + " " + kMessages[random.Below(7)] + " " +
+                   std::to_string(random.Below(100000)) + "\n";
+        }
+        entries.push_back(log);
+    }
+    return entries;
+}
+
+std::vector<std::string> MakeJson(Bench::Random& random) {
+    std::vector<std::string> entries;
+    for (int i = 0; i < 200; i++) {
+        std::string json = "[\n";
+        size_t items = 10 + random.Below(150);
+        for (size_t item = 0; item < items; item++) {
+            json += "  {\"id\": " + std::to_string(random.Below(1000000)) + ", \"name\": \"item" +
+                    std::to_string(random.Below(5000)) + "\", \"active\": " + (random.Below(2) ? "true" : "false") +
+                    ", \"score\": " + std::to_string(random.Below(100)) + "." + std::to_string(random.Below(100)) +
+                    ", \"tags\": [\"alpha\", \"beta\"]}" + (item + 1 < items ? ",\n" : "\n");
+        }
+        entries.push_back(json + "]");
+    }
+    return entries;
+}
+
+std::vector<std::string> MakeShortText(Bench::Random& random) {
+    // Only payloads of 256 bytes and up are compressed when stored
+    std::vector<std::string> entries;
+    for (size_t i = 0; entries.size() < 2000; i++) {
+        std::string text = Bench::MakeText(random, i);
+        if (text.size() >= 256 && text.size() <= 2048) {
+            entries.push_back(text);
+        }
+    }
+    return entries;
+}
+
+void Measure(const Corpus& corpus, size_t rounds) {
+    uint64_t raw = 0;
+    uint64_t stored = 0;
+    double compressSeconds = 0;
+    double decompressSeconds = 0;
+    std::vector<double> compressMicros;
+    std::vector<double> decompressMicros;
+    bool ok = true;
+
+    for (size_t round = 0; round < rounds; round++) {
+        for (const std::string& entry : corpus.entries) {
+            Bench::Stopwatch watch;
+            std::string compressed = Compression::Lz4Compress(entry.data(), entry.size());
+            double micros = watch.Micros();
+            compressSeconds += micros / 1e6;
+            compressMicros.push_back(micros);
+
+            std::string out;
+            watch.Restart();
+            ok = Compression::Lz4Decompress(compressed.data(), compressed.size(), entry.size(), out) && ok;
+            micros = watch.Micros();
+            decompressSeconds += micros / 1e6;
+            decompressMicros.push_back(micros);
+            ok = ok && out == entry;
+
+            if (round == 0) {
+                raw += entry.size();
+                stored += std::min(compressed.size(), entry.size());
+            }
+        }
+    }
+
+    double megabytes = static_cast<double>(raw) * rounds / (1024.0 * 1024.0);
+    std::printf("%-8s %5zu entries  %8.2f MiB  ratio %5.2f  compress %7.1f MiB/s  decompress %7.1f MiB/s%s\n",
+                corpus.name, corpus.entries.size(), static_cast<double>(raw) / (1024.0 * 1024.0),
+                stored > 0 ? static_cast<double>(raw) / static_cast<double>(stored) : 0.0,
+                megabytes / compressSeconds, megabytes / decompressSeconds, ok ? "" : "  ROUND TRIP FAILED");
+    Bench::PrintLatency((std::string(corpus.name) + " compress").c_str(), compressMicros);
+    Bench::PrintLatency((std::string(corpus.name) + " decompress").c_str(), decompressMicros);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t rounds = Bench::SizeArg(argc, argv, 5);
+    Bench::Random random(9);
+
+    std::vector<Corpus> corpora = {
+        { "source", LoadSources() },
+        { "logs", MakeLogs(random) },
+        { "json", MakeJson(random) },
+        { "text", MakeShortText(random) },
+    };
+
+    std::printf("compression_bench: LZ4 block codec, %zu rounds\n", rounds);
+    for (const Corpus& corpus : corpora) {
+        if (!corpus.entries.empty()) {
+            Measure(corpus, rounds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+// In-memory history costs as the history grows. Usage:
+// history_bench [largest history, default 1000000]
+#include "BenchCommon.h"
+#include "ClipboardHistory.h"
+#include "IngestPipeline.h"
+#include "MemoryEngine.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+
+const size_t kMeasured = 200000;
+const size_t kCaptures = 10000;
+const auto kCaptureInterval = std::chrono::microseconds(100);
+const auto kSlowAppend = std::chrono::milliseconds(20);
+
+// Storage that takes kSlowAppend per batch, like a disk that has stalled
+class SlowEngine : public MemoryEngine {
+public:
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override {
+        std::this_thread::sleep_for(kSlowAppend);
+        return MemoryEngine::Append(batch, sync);
+    }
+};
+
+// Distinct clipboard-sized texts, shared by every section
+std::vector<std::string> MakeTexts(size_t count) {
+    Bench::Random random(3);
+    std::vector<std::string> texts;
+    texts.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        texts.push_back("copied text #" + std::to_string(i) + " " + std::to_string(random.Next()));
+    }
+    return texts;
+}
+
+std::vector<size_t> Capacities(size_t largest) {
+    std::vector<size_t> capacities;
+    for (size_t capacity = 100; capacity <= largest; capacity *= 10) {
+        capacities.push_back(capacity);
+    }
+    return capacities;
+}
+
+// Insert into a full history, so every insert also evicts
+void BenchInsert(const std::vector<size_t>& capacities, const std::vector<std::string>& texts) {
+    for (size_t capacity : capacities) {
+        RingBuffer<uint64_t> ring(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            ring.PushFront(i);
+        }
+        Bench::Stopwatch watch;
+        for (size_t i = 0; i < kMeasured; i++) {
+            ring.PushFront(i);
+        }
+        double ringNanos = watch.Seconds() * 1e9 / kMeasured;
+
+        ClipboardHistory history(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            history.AddEntry(texts[i]);
+        }
+        watch.Restart();
+        for (size_t i = capacity; i < capacity + kMeasured; i++) {
+            history.AddEntry(texts[i]);
+        }
+        double historyNanos = watch.Seconds() * 1e9 / kMeasured;
+
+        std::printf("insert at capacity %8zu      ring push %7.1f ns  AddEntry %7.1f ns\n",
+                    capacity, ringNanos, historyNanos);
+    }
+}
+
+// Re-copy random entries already in a full history; each is found in the
+// hash index and promoted to the front instead of added again
+void BenchDedup(const std::vector<size_t>& capacities, const std::vector<std::string>& texts) {
+    for (size_t capacity : capacities) {
+        ClipboardHistory history(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            history.AddEntry(texts[i]);
+        }
+
+        Bench::Random random(capacity);
+        std::vector<size_t> picks(kMeasured);
+        for (size_t& pick : picks) {
+            pick = random.Below(capacity);
+        }
+        Bench::Stopwatch watch;
+        for (size_t pick : picks) {
+            history.AddEntry(texts[pick]);
+        }
+        double nanos = watch.Seconds() * 1e9 / kMeasured;
+
+        std::printf("dedup at size %8zu           re-copy %7.1f ns  (%zu entries kept)\n",
+                    capacity, nanos, history.GetCount());
+    }
+}
+
+// Time IngestPipeline::Submit, the only work left on the capture thread,
+// while storage is stalled and another thread keeps searching the history
+void BenchCapture(const std::vector<std::string>& texts) {
+    ClipboardHistory history(100000);
+    for (size_t i = 0; i < 100000; i++) {
+        history.AddEntry(texts[i]);
+    }
+    Storage storage(std::make_unique<SlowEngine>());
+    storage.Initialize();
+    IngestPipeline pipeline(history, storage);
+    pipeline.Start();
+
+    std::atomic<bool> searching(true);
+    std::thread searcher([&]() {
+        while (searching) {
+            history.Search("text #9");
+        }
+    });
+
+    std::vector<double> micros;
+    micros.reserve(kCaptures);
+    size_t dropped = 0;
+    auto next = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kCaptures; i++) {
+        next += kCaptureInterval;
+        while (std::chrono::steady_clock::now() < next) {
+        }
+        ClipboardEntry entry(texts[100000 + i]);
+        Bench::Stopwatch watch;
+        dropped += pipeline.Submit(std::move(entry)) ? 0 : 1;
+        micros.push_back(watch.Micros());
+    }
+
+    searching = false;
+    searcher.join();
+    pipeline.Stop();
+    storage.Shutdown();
+
+    std::printf("capture: %zu entries every %lld us, storage stalled %lld ms per batch, %zu dropped\n",
+                kCaptures, static_cast<long long>(kCaptureInterval.count()),
+                static_cast<long long>(kSlowAppend.count()), dropped);
+    Bench::PrintLatency("capture Submit", micros);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t largest = Bench::SizeArg(argc, argv, 1000000);
+    std::printf("history_bench: up to %zu entries, %zu measured operations per size\n", largest, kMeasured);
+
+    std::vector<size_t> capacities = Capacities(largest);
+    std::vector<std::string> texts = MakeTexts(std::max(capacities.back(), static_cast<size_t>(100000)) + kMeasured);
+
+    BenchInsert(capacities, texts);
+    BenchDedup(capacities, texts);
+    BenchCapture(texts);
+    return 0;
+}
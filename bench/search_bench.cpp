@@ -0,0 +1,201 @@
+// Search costs: the substring matcher's SIMD paths against the scalar one,
+// indexed queries on a large history against scanning it, and fuzzy
+// ranking as a query is typed.
+// Usage: search_bench [total bytes scanned per case, default 64 MiB]
+#include "BenchCommon.h"
+#include "ClipboardHistory.h"
+#include "TextEncoding.h"
+#include "TextSearch.h"
+
+namespace {
+
+const size_t kIndexedEntries = 1000000;
+const size_t kQueryRounds = 200;
+const size_t kFuzzyEntries = 100000;
+const size_t kFuzzyResults = 10;
+const size_t kKeystrokeRounds = 20;
+
+// Each method on its own, then TextSearch::Find and a TextSearch::Pattern,
+// which pick their own way
+enum class Way { Method, Find, Pattern };
+
+struct MethodCase {
+    const char* name;
+    TextSearch::Method method;
+    Way way;
+};
+
+const MethodCase kMethods[] = {
+    { "scalar", TextSearch::Method::Scalar, Way::Method },
+    { "sse2", TextSearch::Method::Sse2, Way::Method },
+    { "avx2", TextSearch::Method::Avx2, Way::Method },
+    { "find", TextSearch::Method::Scalar, Way::Find },
+    { "pattern", TextSearch::Method::Scalar, Way::Pattern },
+};
+
+size_t FindBy(const MethodCase& method, const TextSearch::Pattern& pattern, std::string_view text,
+              std::string_view needle) {
+    switch (method.way) {
+    case Way::Find:
+        return TextSearch::Find(text, needle);
+    case Way::Pattern:
+        return pattern.Find(text);
+    default:
+        return TextSearch::FindWith(method.method, text, needle);
+    }
+}
+
+// Clipboard text glued together until it is at least size bytes long
+std::string MakeHaystack(Bench::Random& random, size_t size) {
+    std::string haystack;
+    for (size_t i = 0; haystack.size() < size; i++) {
+        haystack += Bench::MakeText(random, i);
+        haystack += '\n';
+    }
+    haystack.resize(size);
+    return haystack;
+}
+
+// Needles that never match, so every search scans the whole haystack: ones
+// whose bytes are all rare, ones that start like common words, so
+// candidate positions keep turning up, and one made only of bytes the
+// haystack is full of
+void BenchSubstring(size_t budget) {
+    static const char* const kNeedles[] = { "qz", "zxqj", "qzjxvkwq", "the zqxj", "the quick brown fox jumps zzz",
+                                            "historyclipboard" };
+    Bench::Random random(5);
+
+    for (size_t size : { 64, 256, 1024, 65536, 1 << 20 }) {
+        std::string haystack = MakeHaystack(random, size);
+        size_t searches = std::max(budget / size, static_cast<size_t>(1));
+        for (const char* needle : kNeedles) {
+            for (const MethodCase& method : kMethods) {
+                if (!TextSearch::IsSupported(method.method)) {
+                    continue;
+                }
+                // Start one byte further in each time, so the compiler
+                // cannot hoist the search out of the loop
+                std::string_view text(haystack);
+                size_t misses = 0;
+                TextSearch::Pattern pattern(needle);
+                Bench::Stopwatch watch;
+                for (size_t i = 0; i < searches; i++) {
+                    misses += FindBy(method, pattern, text.substr(i & 7), needle) == std::string_view::npos;
+                }
+                double seconds = watch.Seconds();
+                std::printf("find %7zu B  %-30s %-7s %9.1f MiB/s%s\n", size, needle, method.name,
+                            static_cast<double>(size) * searches / (1024.0 * 1024.0) / seconds,
+                            misses == searches ? "" : "  UNEXPECTED MATCH");
+            }
+        }
+    }
+}
+
+// A history of count one- and two-line texts, each starting with its
+// number. Long pastes are left out to keep a million entries in memory.
+void FillHistory(ClipboardHistory& history, size_t count) {
+    Bench::Random random(11);
+    for (size_t i = 0; i < count; i++) {
+        std::string text = Bench::MakeText(random, i);
+        while (text.size() > 256) {
+            text = Bench::MakeText(random, i);
+        }
+        history.AddEntry(text);
+    }
+}
+
+// Search on a million entries: a query the trigram index narrows to one
+// entry, one with a trigram no entry has, and common words, which are
+// scanned. The same rare queries scanned through a snapshot show what the
+// index saves.
+void BenchTrigram() {
+    ClipboardHistory history(kIndexedEntries);
+    Bench::Stopwatch watch;
+    FillHistory(history, kIndexedEntries);
+    Bench::PrintRate("trigram fill", static_cast<double>(kIndexedEntries), watch.Seconds(), "entries");
+
+    Bench::Random random(13);
+    std::vector<std::string> rare;
+    for (size_t i = 0; i < kQueryRounds; i++) {
+        rare.push_back(std::to_string(kIndexedEntries / 10 + random.Below(kIndexedEntries - kIndexedEntries / 10)) + " ");
+    }
+    struct QueryCase {
+        const char* name;
+        std::vector<std::string> queries;
+    };
+    const QueryCase cases[] = {
+        { "trigram rare", rare },
+        { "trigram absent", std::vector<std::string>(kQueryRounds / 10, "zebra") },
+        { "trigram common words", std::vector<std::string>(kQueryRounds / 10, "password fix") },
+    };
+
+    for (const QueryCase& query : cases) {
+        std::vector<double> micros;
+        size_t results = 0;
+        for (const std::string& text : query.queries) {
+            watch.Restart();
+            results += history.Search(text).size();
+            micros.push_back(watch.Micros());
+        }
+        std::printf("%-32s %zu queries, %.1f results each\n", query.name, query.queries.size(),
+                    static_cast<double>(results) / query.queries.size());
+        Bench::PrintLatency(query.name, micros);
+    }
+
+    // The scan Search falls back to, for the rare queries
+    HistorySnapshot snapshot = history.GetSnapshot();
+    std::vector<double> micros;
+    size_t results = 0;
+    for (size_t i = 0; i < rare.size() / 10; i++) {
+        std::string lowerQuery;
+        TextEncoding::LowerCase(rare[i], lowerQuery);
+        watch.Restart();
+        for (size_t index = 0; index < snapshot.Size(); index++) {
+            results += TextSearch::Contains(snapshot[index].folded, lowerQuery);
+        }
+        micros.push_back(watch.Micros());
+    }
+    std::printf("%-32s %zu queries, %.1f results each\n", "snapshot scan rare", micros.size(),
+                static_cast<double>(results) / micros.size());
+    Bench::PrintLatency("snapshot scan rare", micros);
+}
+
+// RankFuzzy over 100k entries for each prefix of a query as it is typed,
+// keeping the best kFuzzyResults as the history window does
+void BenchFuzzy() {
+    ClipboardHistory history(kFuzzyEntries);
+    FillHistory(history, kFuzzyEntries);
+    HistorySnapshot snapshot = history.GetSnapshot();
+
+    static const char* const kQueries[] = { "clphst", "pswdfx", "https exmpl", "48392" };
+    std::vector<double> all;
+    for (const char* query : kQueries) {
+        std::string typed;
+        for (const char* key = query; *key; key++) {
+            typed.push_back(*key);
+            std::vector<double> micros;
+            size_t ranked = 0;
+            for (size_t round = 0; round < kKeystrokeRounds; round++) {
+                Bench::Stopwatch watch;
+                ranked = ClipboardHistory::RankFuzzy(snapshot, typed, kFuzzyResults).size();
+                micros.push_back(watch.Micros());
+            }
+            all.insert(all.end(), micros.begin(), micros.end());
+            std::string label = "fuzzy \"" + typed + "\" (" + std::to_string(ranked) + ")";
+            Bench::PrintLatency(label.c_str(), micros);
+        }
+    }
+    Bench::PrintLatency("fuzzy any keystroke", all);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t budget = Bench::SizeArg(argc, argv, 64 << 20);
+    std::printf("search_bench: %zu bytes scanned per substring case\n", budget);
+
+    BenchSubstring(budget);
+    BenchTrigram();
+    BenchFuzzy();
+    return 0;
+}
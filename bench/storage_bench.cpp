@@ -0,0 +1,152 @@
+// Append, load, scan and compact the same workload through every storage
+// engine. Usage: storage_bench [entries]
+#include "BenchCommon.h"
+#include "FileEngine.h"
+#include "MappedEngine.h"
+#include "MemoryEngine.h"
+#include "SegmentedEngine.h"
+#include "SqliteEngine.h"
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+namespace {
+
+const size_t kDefaultEntries = 100000;
+const size_t kBatchSize = 64;
+const size_t kRandomReads = 10000;
+const size_t kLatencySamples = 2000;
+
+struct EngineCase {
+    const char* name;
+    bool persistent; // Whether a reopened engine sees what was written
+    std::function<std::unique_ptr<StorageEngine>(const std::wstring&)> create;
+};
+
+std::string Label(const char* engine, const char* phase) {
+    return std::string(engine) + " " + phase;
+}
+
+bool RunCase(const EngineCase& engineCase, const std::vector<ClipboardEntry>& entries,
+             const std::filesystem::path& dir) {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::wstring path = (dir / "history.db").wstring();
+
+    std::unique_ptr<StorageEngine> engine = engineCase.create(path);
+    if (!engine->Open()) {
+        std::printf("%s: open failed\n", engineCase.name);
+        return false;
+    }
+
+    // Append in writer-thread sized batches, then the last few entries one
+    // at a time, as the writer does while capture is quiet
+    size_t single = std::min(kLatencySamples, entries.size() / 2);
+    size_t batched = entries.size() - single;
+    Bench::Stopwatch watch;
+    std::vector<ClipboardEntry> batch;
+    for (size_t i = 0; i < batched; i += kBatchSize) {
+        size_t end = std::min(batched, i + kBatchSize);
+        batch.assign(entries.begin() + i, entries.begin() + end);
+        if (!engine->Append(batch, false)) {
+            std::printf("%s: append failed\n", engineCase.name);
+            return false;
+        }
+    }
+    engine->Sync();
+    Bench::PrintRate(Label(engineCase.name, "append").c_str(), static_cast<double>(batched), watch.Seconds(), "entries");
+
+    std::vector<double> latency;
+    latency.reserve(single);
+    for (size_t i = batched; i < entries.size(); i++) {
+        batch.assign(1, entries[i]);
+        watch.Restart();
+        if (!engine->Append(batch, false)) {
+            std::printf("%s: append failed\n", engineCase.name);
+            return false;
+        }
+        latency.push_back(watch.Micros());
+    }
+    Bench::PrintLatency(Label(engineCase.name, "append one").c_str(), latency);
+
+    // Load: reopen, then read the newest page the history window starts with
+    if (engineCase.persistent) {
+        engine->Close();
+        engine = engineCase.create(path);
+        watch.Restart();
+        if (!engine->Open()) {
+            std::printf("%s: reopen failed\n", engineCase.name);
+            return false;
+        }
+        std::printf("%-32s %12.2f ms\n", Label(engineCase.name, "reopen").c_str(), watch.Seconds() * 1e3);
+    }
+    watch.Restart();
+    std::vector<ClipboardEntry> latest = engine->LoadLatest(100);
+    std::printf("%-32s %12.2f ms  (%zu entries)\n", Label(engineCase.name, "load latest 100").c_str(),
+                watch.Seconds() * 1e3, latest.size());
+
+    // Scan everything oldest first
+    watch.Restart();
+    size_t scanned = 0;
+    uint64_t bytes = 0;
+    engine->ForEach([&](const ClipboardEntry& entry) {
+        scanned++;
+        bytes += entry.TextSize();
+        return true;
+    });
+    Bench::PrintRate(Label(engineCase.name, "scan").c_str(), static_cast<double>(scanned), watch.Seconds(), "entries");
+
+    // Random access by position
+    Bench::Random random(99);
+    ClipboardEntry entry;
+    watch.Restart();
+    for (size_t i = 0; i < kRandomReads; i++) {
+        engine->ReadAt(random.Below(entries.size()), entry);
+    }
+    Bench::PrintRate(Label(engineCase.name, "read at").c_str(), static_cast<double>(kRandomReads), watch.Seconds(), "reads");
+
+    // Compact down to a quarter, forced so every engine does the work
+    watch.Restart();
+    bool compacted = engine->Compact(entries.size() / 4, 0.0);
+    std::printf("%-32s %12.2f ms  (%s, %llu left)\n", Label(engineCase.name, "compact to 25%").c_str(),
+                watch.Seconds() * 1e3, compacted ? "compacted" : "skipped",
+                static_cast<unsigned long long>(engine->GetStats().entryCount));
+
+    engine->Close();
+    engine.reset();
+    std::filesystem::remove_all(dir);
+    return scanned == entries.size();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t count = Bench::SizeArg(argc, argv, kDefaultEntries);
+
+    Bench::Random random(1);
+    std::vector<ClipboardEntry> entries;
+    entries.reserve(count);
+    auto start = std::chrono::system_clock::now() - std::chrono::hours(24);
+    for (size_t i = 0; i < count; i++) {
+        entries.emplace_back(Bench::MakeText(random, i));
+        entries.back().timestamp = start + std::chrono::milliseconds(i * 100);
+    }
+
+    std::vector<EngineCase> cases = {
+        { "memory", false, [](const std::wstring&) { return std::make_unique<MemoryEngine>(); } },
+        { "file", true, [](const std::wstring& path) { return std::make_unique<FileEngine>(path); } },
+        { "mapped", true, [](const std::wstring& path) { return std::make_unique<MappedEngine>(path); } },
+        { "segmented", true, [](const std::wstring& path) { return std::make_unique<SegmentedEngine>(path); } },
+#ifdef CLIPPY2000_HAVE_SQLITE
+        { "sqlite", true, [](const std::wstring& path) { return std::make_unique<SqliteEngine>(path); } },
+#endif
+    };
+
+    std::printf("storage_bench: %zu entries\n", count);
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "clippy2000_storage_bench";
+    bool ok = true;
+    for (const EngineCase& engineCase : cases) {
+        ok = RunCase(engineCase, entries, dir) && ok;
+    }
+    return ok ? 0 : 1;
+}
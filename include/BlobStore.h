@@ -0,0 +1,112 @@
+#pragma once
+
+#include "LogFile.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+// Content-addressed store for clipboard payloads, keyed by their XXH64 hash.
+// Each distinct payload is written once; log records refer to it by hash and
+// the store counts those references so compaction can drop unused blobs.
+// Larger payloads are kept LZ4-compressed and only expanded by Read.
+//
+// File layout (little-endian): 16-byte header ("CLPB", u32 version,
+// u64 store id, new whenever the store is reset or rewritten), then one
+// record per blob: u64 hash, u32 stored size, u32 raw size, payload (LZ4
+// block when stored size < raw size).
+// Version 1 stores (no raw size) are upgraded when opened.
+//
+// The blob table is saved to "<path>.idx" on Close and after a rewrite:
+// 32-byte header ("CLPT", u32 version, u64 store id, u64 store bytes it
+// covers, u64 reserved), then one 24-byte entry per blob sorted by hash:
+// u64 hash, u64 payload offset, u32 stored size, u32 raw size. Open maps it
+// and only walks the records appended after it was saved, so opening does
+// not read the whole store.
+class BlobStore {
+public:
+    BlobStore();
+    ~BlobStore();
+
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    // Open (creating if needed) the store and its saved blob table.
+    // Reference counts start at zero; the owner re-adds the references it
+    // holds before relying on them.
+    bool Open(const std::wstring& path);
+
+    // Save the blob table if it changed, and close the store
+    void Close();
+
+    // Drop every blob
+    bool Reset();
+
+    // Add a reference to data, staging it for Commit if it is new. Returns
+    // false on a hash collision with different bytes; store the data inline.
+    bool AddRef(uint64_t hash, const std::string& data);
+
+    // Add or drop a reference to a blob that is already stored
+    void AddRef(uint64_t hash);
+    void Release(uint64_t hash);
+
+    // Set every reference count back to zero, for an owner about to re-add
+    // the references it still holds
+    void ClearRefs();
+
+    // Write blobs staged by AddRef in a single append
+    bool Commit();
+    bool Sync();
+
+    // Copy a blob's bytes into data, decompressing them if needed
+    bool Read(uint64_t hash, std::string& data);
+
+    // Bytes in the store, including blobs staged for Commit
+    uint64_t Size();
+
+    // Rewrite the store without blobs that have no references left
+    bool Compact();
+
+private:
+    struct Blob {
+        uint64_t offset; // Of the payload, not the record
+        uint32_t size;   // As stored
+        uint32_t rawSize;
+        uint64_t refs;
+    };
+
+    std::wstring m_path;
+    std::mutex m_mutex;
+    LogFile m_file;
+    MappedFile m_map;
+    uint64_t m_storeId;
+
+    // The saved table, and the blobs added since it was saved or looked up
+    // in it. A blob in both is described by m_blobs.
+    MappedFile m_table;
+    size_t m_tableCount;
+    bool m_tableStale; // Whether Close must save the table
+    std::unordered_map<uint64_t, Blob> m_blobs;
+    std::string m_pending; // Records staged past the end of m_file
+
+    // The blob with this hash, copied out of the saved table into m_blobs
+    // the first time it is asked for; nullptr if there is none
+    Blob* Find(uint64_t hash);
+
+    // Map the saved table if it describes this store, and add the records
+    // past the bytes it covers to m_blobs. Returns where those records end.
+    uint64_t LoadTable(size_t recordHeaderSize);
+    bool SaveTable();
+
+    // Reset the store to an empty file with a new id
+    bool CreateStore();
+
+    // Pointer to a blob's stored bytes in the mapped view or the staging buffer
+    const char* Locate(const Blob& blob);
+    bool ReadBlob(const Blob& blob, std::string& data);
+
+    // Rewrite the store in the current format, optionally dropping blobs
+    // with no references
+    bool Rewrite(bool dropUnreferenced);
+};
@@ -1,9 +1,21 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <list>
+#include <functional>
+#include "HashIndex.h"
+#include "RingBuffer.h"
+#include "TextArena.h"
+#include "TrigramIndex.h"
+
+class BlobStore;
+class Storage;
 
 enum class ClipboardDataType {
     Text,
@@ -11,27 +23,109 @@ enum class ClipboardDataType {
     Files
 };
 
+// Text a storage engine left where it keeps it, such as a compressed blob,
+// to be read only if the entry's text is actually used
+class StoredText {
+public:
+    virtual ~StoredText() = default;
+
+    virtual size_t Size() const = 0;
+    virtual uint64_t Hash() const = 0; // XXH64 of the text, as the history hashes it
+    virtual bool Read(std::string& text) const = 0;
+};
+
 struct ClipboardEntry {
     ClipboardDataType type;
-    std::wstring text;  // For text or file paths (semicolon-separated)
+    std::string text;   // UTF-8 text or file paths (semicolon-separated)
     std::chrono::system_clock::time_point timestamp;
 
+    // Set by storage engines in place of text for entries whose text they
+    // keep elsewhere; text stays empty until LoadText reads it
+    std::shared_ptr<const StoredText> stored;
+
     ClipboardEntry()
         : type(ClipboardDataType::Text), timestamp(std::chrono::system_clock::now()) {}
 
-    ClipboardEntry(const std::wstring& t, ClipboardDataType dataType = ClipboardDataType::Text)
+    ClipboardEntry(const std::string& t, ClipboardDataType dataType = ClipboardDataType::Text)
         : type(dataType), text(t), timestamp(std::chrono::system_clock::now()) {}
+
+    // Bytes in the text, whether it is loaded or not
+    size_t TextSize() const { return stored ? stored->Size() : text.size(); }
+
+    // Read stored text into text. False, leaving text empty, if it can no
+    // longer be read (a blob lost with an unsynced store).
+    bool LoadText() {
+        if (!stored) {
+            return true;
+        }
+        bool ok = stored->Read(text);
+        if (!ok) {
+            text.clear();
+        }
+        stored.reset();
+        return ok;
+    }
+};
+
+// An entry as seen through a snapshot. The text points into the history's
+// text arena and stays valid for as long as the snapshot is held. For an
+// entry whose body was spilled it is only a preview; HistorySnapshot::
+// GetEntry loads the whole text.
+struct HistoryItem {
+    ClipboardDataType type;
+    std::string_view text;
+    std::string_view folded; // text through TextEncoding::LowerCase, for search
+    std::chrono::system_clock::time_point timestamp;
+    size_t size;   // Bytes in the whole text
+    uint64_t hash;
+    bool spilled;
+};
+
+// Immutable view of the history at one point in time, newest first.
+// Snapshots share the history's text and each other's, so copying or
+// keeping one never copies text.
+class HistorySnapshot {
+public:
+    HistorySnapshot() = default;
+
+    size_t Size() const { return m_data ? m_data->items.size() : 0; }
+    bool Empty() const { return Size() == 0; }
+    const HistoryItem& operator[](size_t index) const { return m_data->items[index]; }
+
+    // Whether both are the same snapshot of the same history state
+    bool SameAs(const HistorySnapshot& other) const { return m_data == other.m_data; }
+
+    // Owning copy of an entry, with its whole text. Reads the spill store
+    // for a spilled entry; false if the body is no longer there.
+    bool GetEntry(size_t index, ClipboardEntry& entry) const;
+
+private:
+    friend class ClipboardHistory;
+
+    struct Data {
+        uint64_t version;
+        BlobStore* spill;
+        std::vector<HistoryItem> items;
+        std::vector<std::shared_ptr<const TextArena::Chunk>> chunks; // Keeps the text alive
+    };
+    std::shared_ptr<const Data> m_data;
 };
 
 class ClipboardHistory {
 public:
     ClipboardHistory(size_t maxEntries = 100);
 
-    // Add a new clipboard entry
-    void AddEntry(const std::wstring& text, ClipboardDataType type = ClipboardDataType::Text);
+    // Add a new clipboard entry. Text already in the history is moved to
+    // the front instead of being stored twice.
+    void AddEntry(const std::string& text, ClipboardDataType type = ClipboardDataType::Text);
+
+    // Same, keeping the entry's own capture timestamp
+    void AddEntry(ClipboardEntry entry);
 
-    // Get all entries (newest first)
-    std::vector<ClipboardEntry> GetEntries() const;
+    // Current entries (newest first). O(1) and lock-free when nothing has
+    // changed since the last snapshot; otherwise the first caller builds
+    // the new one from views into the text arena, without copying any text.
+    HistorySnapshot GetSnapshot() const;
 
     // Get entry count
     size_t GetCount() const;
@@ -42,14 +136,176 @@ public:
     // Set maximum number of entries
     void SetMaxEntries(size_t maxEntries);
 
-    // Search entries by text (case-insensitive)
-    std::vector<ClipboardEntry> Search(const std::wstring& query) const;
+    // Also evict the oldest entries while the history holds more than
+    // maxBytes (0 = no limit). Counts each entry's text held in memory plus
+    // its bookkeeping; an entry that cannot fit on its own is not added.
+    // Arena chunks are compacted once half garbage, so the text allocated
+    // stays under about twice the budget.
+    void SetMaxBytes(size_t maxBytes);
+
+    // Keep only a preview in memory of entries of spillBytes or more, with
+    // their whole text in store. The store is cleared and then owned by the
+    // history; it must outlive it and every snapshot. Set before adding
+    // entries.
+    void SetSpillStore(BlobStore* store, size_t spillBytes);
+
+    // Bytes counted against the budget
+    size_t GetBytes() const;
+
+    // Serve entries older than the ones in memory (the hot window) from
+    // storage, reading pageEntries at a time and keeping up to cacheBytes of
+    // recently used pages. Storage must outlive the history. Set before use.
+    void SetColdStorage(Storage* storage, size_t pageEntries = 64, size_t cacheBytes = 8 * 1024 * 1024);
+
+    // Search entries in storage captured before the oldest entry in memory
+    // (case-insensitive), newest first, through the page cache. Each text is
+    // listed once: earlier copies of text that is in memory, or that was
+    // captured again later, are skipped. Stops after maxResults matches or
+    // maxScanned stored entries (0 = no limit), so a search over a long
+    // history can be bounded, or once cancelled returns true, which is
+    // checked before each page read.
+    std::vector<ClipboardEntry> SearchCold(const std::string& query, size_t maxResults, size_t maxScanned = 0,
+                                           const std::function<bool()>& cancelled = nullptr) const;
+
+    // Search entries by UTF-8 text (case-insensitive). A query of three or
+    // more bytes is looked up in the trigram index and only the candidates
+    // are checked. A query too short or too common for the index to narrow
+    // scans a snapshot instead, so a long search does not hold up AddEntry.
+    std::vector<ClipboardEntry> Search(const std::string& query) const;
+
+    // Fuzzy search (see FuzzyMatch): the maxResults best scoring entries,
+    // best first, newer first among equal scores.
+    std::vector<ClipboardEntry> SearchFuzzy(const std::string& query, size_t maxResults) const;
+
+    // Same ranking over a snapshot, as indexes into it, so a view holding
+    // one lists the same entries. Scores every entry but keeps only the
+    // best maxResults in a bounded heap, so only those are sorted.
+    static std::vector<size_t> RankFuzzy(const HistorySnapshot& snapshot, const std::string& query, size_t maxResults);
 
 private:
-    std::vector<ClipboardEntry> m_entries;
+    // A ring slot. Entries moved to the front leave a dead slot behind, so
+    // a promotion never shifts the entries after it. The text lives in
+    // m_text, so adding an entry allocates nothing once the ring, the index
+    // and the current arena chunk have room.
+    struct Slot {
+        TextArena::Ref text;      // Owned only while live; a preview if spilled
+        TextArena::Ref folded;    // Lowercase text, owned separately unless foldedIsText
+        uint64_t id = 0;          // Key in m_trigrams; kept on promotion and compaction
+        ClipboardDataType type = ClipboardDataType::Text;
+        std::chrono::system_clock::time_point timestamp;
+        size_t size = 0;          // Bytes in the whole text
+        uint64_t hash = 0;
+        bool spilled = false;     // Whole text is in m_spill under hash
+        bool foldedIsText = false; // Lowercasing changed nothing; folded is text
+        bool live = false;
+    };
+
+    RingBuffer<Slot> m_slots; // Newest first, dead slots included
+    TextArena m_text;
     size_t m_maxEntries;
+    size_t m_maxBytes;        // 0 = no limit
+    size_t m_bytes;           // Counted bytes of the live entries
+    size_t m_dead;            // Dead slots in m_slots
+
+    // Bodies of large entries. Released blobs stay in the file until it is
+    // compacted, once they outnumber the live ones.
+    BlobStore* m_spill;
+    size_t m_spillBytes;
+    size_t m_spillLive;
+    size_t m_spillReleased;
+
+    // Content hash of every live entry -> its sequence number. Slot i (from
+    // the newest) holds sequence number m_nextSeq - 1 - i.
+    HashIndex m_index;
+    uint64_t m_nextSeq;
+
+    // Trigrams of each live entry's folded text, by entry id, and each live
+    // id's sequence number. Evicted ids stay in the trigram lists until they
+    // outnumber the live ones and the index is rebuilt.
+    TrigramIndex m_trigrams;
+    HashIndex m_ids;
+    uint64_t m_nextId;
+    size_t m_staleIds;
+
     mutable std::mutex m_mutex;
 
-    // Check if entry already exists (avoid duplicates)
-    bool IsDuplicate(const std::wstring& text) const;
+    // Bumped on every change. m_snapshot is read and replaced with the
+    // atomic shared_ptr functions, so readers can take it without m_mutex.
+    std::atomic<uint64_t> m_version;
+    mutable std::shared_ptr<const HistorySnapshot::Data> m_snapshot;
+
+    // Cold tier. Page n holds the stored entries n * m_pageEntries onwards,
+    // counted from the oldest, so appends leave cached pages in place and
+    // only move the boundary with the hot window. A compaction or clear
+    // (a new storage epoch) drops them all. The newest page may be short
+    // and is read again when more of it is wanted.
+    struct ColdPage {
+        size_t number;
+        std::vector<ClipboardEntry> entries; // Oldest first; text loaded once searched
+        std::vector<uint64_t> hashes; // Of each entry's text
+        size_t bytes;
+    };
+
+    Storage* m_storage;
+    size_t m_pageEntries;
+    size_t m_coldCacheBytes;
+    mutable std::mutex m_coldMutex;          // Guards the page cache; taken before m_mutex
+    mutable std::list<ColdPage> m_coldPages; // Most recently used first
+    mutable size_t m_coldBytes;
+    mutable uint64_t m_coldEpoch;            // Storage epoch the cached pages were read in
+
+    // Sequence number of the live entry with this text, if any. A spilled
+    // entry only matches text that was just added to the spill store, which
+    // checked the bytes.
+    bool Find(const std::string& text, uint64_t hash, bool spilled, uint64_t& seq) const;
+
+    // Give up a reference to a spilled body
+    void ReleaseSpill(uint64_t hash);
+
+    // Bytes an entry with this much text in memory counts against the budget
+    static size_t EntryBytes(size_t textBytes);
+
+    // Arena bytes a slot holds, its folded copy included
+    static size_t SlotTextBytes(const Slot& slot);
+
+    // Give a live slot's text back to the arena
+    void ReleaseText(const Slot& slot);
+
+    std::string_view FoldedText(const Slot& slot) const;
+
+    // Index every live entry again, dropping the evicted ids
+    void RebuildTrigrams();
+
+    // Search through the trigram index, newest first. False, with nothing
+    // done, if the query's trigrams are too common for the index to help.
+    bool SearchIndexed(const std::string& lowerQuery, const std::vector<uint32_t>& trigrams,
+                       std::vector<ClipboardEntry>& results) const;
+
+    // Drop dead slots and renumber the index, and copy the live text into
+    // fresh chunks if the arena is mostly released text. O(n), but only
+    // needed once the dead slots fill the ring's spare capacity or the
+    // arena's garbage outgrows its live text.
+    void Compact();
+
+    // Whether the arena holds more released text than live text
+    bool TextFragmented() const;
+
+    // Drop the oldest slots while the live entries are over either limit
+    void Trim();
+
+    // Storage position of the newest cold entry
+    size_t ColdStart() const;
+
+    // How many stored entries, counted from the oldest, are cold, and the
+    // storage epoch that count holds in; false if storage kept changing
+    // while it was taken
+    bool GetColdRange(size_t& cold, uint64_t& epoch) const;
+
+    // A cold page with at least minEntries entries, from the cache or
+    // storage; null if storage kept changing while it was read or has fewer
+    // entries. Caller holds m_coldMutex.
+    ColdPage* GetColdPage(size_t number, size_t minEntries) const;
+
+    // Whether text is live in memory
+    bool IsHot(const std::string& text, uint64_t hash) const;
 };
@@ -4,16 +4,18 @@
 #include <string>
 #include "ClipboardHistory.h"
 
+// The Win32 clipboard boundary. Everything else handles text as UTF-8;
+// conversion to and from UTF-16 happens only here.
 class ClipboardUtils {
 public:
-    // Set clipboard text
-    static bool SetClipboardText(const std::wstring& text);
+    // Set clipboard text (UTF-8)
+    static bool SetClipboardText(const std::string& text);
 
-    // Get clipboard text
-    static std::wstring GetClipboardText();
+    // Get clipboard text as UTF-8
+    static std::string GetClipboardText();
 
-    // Get clipboard file paths
-    static std::wstring GetClipboardFiles();
+    // Get clipboard file paths as UTF-8 (semicolon-separated)
+    static std::string GetClipboardFiles();
 
     // Detect clipboard data type
     static ClipboardDataType GetClipboardDataType();
@@ -23,5 +25,5 @@ public:
 
 private:
     // Restore files to clipboard in CF_HDROP format
-    static bool RestoreFilesToClipboard(const std::wstring& filePaths);
+    static bool RestoreFilesToClipboard(const std::string& filePaths);
 };
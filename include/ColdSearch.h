@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ClipboardHistory.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs ClipboardHistory::SearchCold on a worker thread, so the storage
+// reads behind it never hold up the thread that asks. Only the newest
+// request matters: it replaces one still waiting, and stops one running at
+// its next page read. The done callback reports each search that finished
+// without being replaced; TakeResults hands over its matches.
+class ColdSearch {
+public:
+    using DoneCallback = std::function<void()>;
+
+    // Each search reads at most maxScanned stored entries (0 = no limit)
+    ColdSearch(const ClipboardHistory& history, size_t maxScanned);
+    ~ColdSearch();
+
+    ColdSearch(const ColdSearch&) = delete;
+    ColdSearch& operator=(const ColdSearch&) = delete;
+
+    // Called on the worker thread; set before Start
+    void SetDoneCallback(DoneCallback callback);
+
+    bool Start();
+    void Stop();
+
+    // Start a search in place of any earlier one. Returns its ticket.
+    uint64_t Request(const std::string& query, size_t maxResults);
+
+    // Drop the current request, running or not
+    void Cancel();
+
+    // The matches of the search with this ticket, once it is done and if
+    // nothing replaced it
+    bool TakeResults(uint64_t ticket, std::vector<ClipboardEntry>& results);
+
+private:
+    const ClipboardHistory& m_history;
+    size_t m_maxScanned;
+    DoneCallback m_doneCallback;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    bool m_stopping;
+
+    // The newest ticket handed out, read by a running search to notice it
+    // was replaced; written under m_mutex
+    std::atomic<uint64_t> m_requested;
+    std::string m_query;
+    size_t m_maxResults;
+    uint64_t m_started;  // Newest ticket the worker took up
+    uint64_t m_finished; // Ticket m_results belong to, 0 if none
+    std::vector<ClipboardEntry> m_results;
+
+    void WorkerLoop();
+};
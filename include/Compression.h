@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// LZ4 block format codec for stored payloads. Compresses with a single-pass
+// greedy matcher (fast, moderate ratio); output is readable by any LZ4 block
+// decoder and vice versa.
+class Compression {
+public:
+    // Compress size bytes of data into LZ4 block format
+    static std::string Lz4Compress(const char* data, size_t size);
+
+    // Decompress an LZ4 block that expands to exactly rawSize bytes.
+    // Returns false on malformed input.
+    static bool Lz4Decompress(const char* data, size_t size, size_t rawSize, std::string& out);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "StorageEngine.h"
+#include "BlobStore.h"
+#include "LogFile.h"
+#include "MappedFile.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only binary log with a sidecar offset index ("<path>.idx") and a
+// content-addressed store for large payloads ("<path>.blobs"). Reads walk
+// the log with buffered file reads; random access goes through a mapped view.
+class FileEngine : public StorageEngine {
+public:
+    explicit FileEngine(const std::wstring& path);
+    ~FileEngine() override;
+
+    FileEngine(const FileEngine&) = delete;
+    FileEngine& operator=(const FileEngine&) = delete;
+
+    bool Open() override;
+    void Close() override;
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override;
+    bool Sync() override;
+    std::vector<ClipboardEntry> LoadLatest(size_t limit) override;
+    void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) override;
+    bool ReadAt(size_t position, ClipboardEntry& entry) override;
+    bool FindByTime(std::chrono::system_clock::time_point time, size_t& position) override;
+    StorageStats GetStats() override;
+    bool Clear() override;
+    bool Compact(size_t retainEntries, double minSizeRatio) override;
+
+    // Bytes in the log and its blob store
+    uint64_t DiskSize();
+
+protected:
+    // Decode the record at an index slot (0 = oldest) through the mapped
+    // view. Caller holds m_indexMutex.
+    bool ReadIndexed(size_t slot, ClipboardEntry& entry);
+
+    // Offset index and counters over the log, appended to by Append.
+    // Lock order: m_fileMutex before m_indexMutex.
+    struct IndexEntry {
+        uint64_t offset;
+        int64_t timestampMs;
+    };
+    std::mutex m_indexMutex;
+    std::vector<IndexEntry> m_index;
+
+private:
+    std::wstring m_path;
+    uint64_t m_logId;
+
+    // m_fileMutex serializes everything that writes m_file or m_indexFile
+    std::mutex m_fileMutex;
+    LogFile m_file;
+    LogFile m_indexFile;
+    MappedFile m_map;
+    StorageStats m_stats;
+
+    // Large payloads, stored once and referenced by hash from the log.
+    // Guarded by its own lock; written under m_fileMutex. Shared with the
+    // entries read from the log that have not loaded their text yet.
+    std::shared_ptr<BlobStore> m_blobs;
+
+    // Reset the log to an empty file with a new log id
+    bool CreateLog();
+
+    // Load the sidecar index, validate it and catch it up with the log
+    bool LoadIndex();
+    bool EnsureMapped(uint64_t end);
+
+    // Load the header counters, recounting records past the committed size
+    bool LoadStats();
+
+    // Convert a file written in the old "timestamp|type|text" line format
+    bool MigrateLegacyFile();
+
+    // Rewrite a log from an older binary format version
+    bool UpgradeLog();
+
+    // Check the CRCs of the records past the committed size and cut the log
+    // at the first bad one
+    bool RecoverLog();
+};
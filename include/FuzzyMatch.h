@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// fzf-style fuzzy matching: the pattern's bytes must appear in the text in
+// order, not necessarily together. A match scores 16 per matched byte,
+// loses points for each gap, and gains bonuses for starting a word, for a
+// camelCase hump or digit run, and for continuing a run of matches, so
+// "clphst" ranks "ClipboardHistory" above a text where the letters are
+// scattered.
+//
+// One pass finds the earliest match and a second walks back from its end
+// to the latest start, so the scored window is short; the cost is linear
+// in the text and non-matches are rejected with memchr.
+class FuzzyMatch {
+public:
+    // Score a lowercase pattern against an entry's folded text. text is the
+    // original, consulted for camelCase when it lines up byte for byte with
+    // folded. False if the pattern is not a subsequence of folded.
+    static bool Score(std::string_view text, std::string_view folded, std::string_view pattern, int& score);
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Hash {
+public:
+    // 64-bit xxHash (XXH64) of the given bytes
+    static uint64_t XXH64(const void* data, size_t size, uint64_t seed = 0);
+
+    // CRC-32C (Castagnoli). Pass a previous result as crc to continue it.
+    // Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+    static uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0);
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open-addressing multimap from a 64-bit content hash to a 64-bit value,
+// for callers that already hash their keys. One flat table with linear
+// probing: inserts and erases never allocate until the table has to grow,
+// and lookups touch a couple of adjacent cache lines.
+//
+// Several values may share a hash; ForEach visits all of them.
+class HashIndex {
+public:
+    explicit HashIndex(size_t expected = 0)
+        : m_mask(0)
+        , m_size(0)
+    {
+        Reserve(expected);
+    }
+
+    size_t Size() const { return m_size; }
+
+    // Make room for this many entries without growing
+    void Reserve(size_t expected) {
+        size_t size = 16;
+        while (size < expected * 2) {
+            size <<= 1;
+        }
+        if (size > m_slots.size()) {
+            Rehash(size);
+        }
+    }
+
+    void Insert(uint64_t hash, uint64_t value) {
+        if ((m_size + 1) * 2 > m_slots.size()) {
+            Rehash(m_slots.size() * 2);
+        }
+        size_t i = static_cast<size_t>(hash) & m_mask;
+        while (m_slots[i].used) {
+            i = (i + 1) & m_mask;
+        }
+        m_slots[i].hash = hash;
+        m_slots[i].value = value;
+        m_slots[i].used = true;
+        m_size++;
+    }
+
+    // Remove one matching entry. Returns whether there was one.
+    bool Erase(uint64_t hash, uint64_t value) {
+        size_t i = static_cast<size_t>(hash) & m_mask;
+        while (m_slots[i].used) {
+            if (m_slots[i].hash == hash && m_slots[i].value == value) {
+                RemoveAt(i);
+                return true;
+            }
+            i = (i + 1) & m_mask;
+        }
+        return false;
+    }
+
+    // Call visit(value) for each entry with this hash until it returns true.
+    // Returns whether it did.
+    template <typename Visit>
+    bool ForEach(uint64_t hash, Visit visit) const {
+        size_t i = static_cast<size_t>(hash) & m_mask;
+        while (m_slots[i].used) {
+            if (m_slots[i].hash == hash && visit(m_slots[i].value)) {
+                return true;
+            }
+            i = (i + 1) & m_mask;
+        }
+        return false;
+    }
+
+    // Remove everything, keeping the table
+    void Clear() {
+        for (Slot& slot : m_slots) {
+            slot.used = false;
+        }
+        m_size = 0;
+    }
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint64_t value = 0;
+        bool used = false;
+    };
+
+    std::vector<Slot> m_slots; // Power-of-two size, at most half full
+    size_t m_mask;
+    size_t m_size;
+
+    // Backward-shift deletion: pull later entries of the probe run into the
+    // hole, so lookups never need tombstones
+    void RemoveAt(size_t hole) {
+        size_t i = hole;
+        while (true) {
+            i = (i + 1) & m_mask;
+            if (!m_slots[i].used) {
+                break;
+            }
+            size_t home = static_cast<size_t>(m_slots[i].hash) & m_mask;
+            // Move it only if its home is not between the hole and here
+            if (((i - home) & m_mask) >= ((i - hole) & m_mask)) {
+                m_slots[hole] = m_slots[i];
+                hole = i;
+            }
+        }
+        m_slots[hole].used = false;
+        m_size--;
+    }
+
+    void Rehash(size_t size) {
+        std::vector<Slot> old;
+        old.swap(m_slots);
+        m_slots.resize(size);
+        m_mask = size - 1;
+        m_size = 0;
+        for (const Slot& slot : old) {
+            if (slot.used) {
+                Insert(slot.hash, slot.value);
+            }
+        }
+    }
+};
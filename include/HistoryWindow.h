@@ -6,6 +6,8 @@
 #include <vector>
 #include <functional>
 #include "ClipboardHistory.h"
+#include "ColdSearch.h"
+#include "SearchSession.h"
 
 class HistoryWindow {
 public:
@@ -23,14 +25,23 @@ public:
     bool IsVisible() const;
 
     // Update the history list
-    void UpdateHistory(const std::vector<ClipboardEntry>& entries);
+    void UpdateHistory(const HistorySnapshot& entries);
 
     // Refresh the display if window is visible
-    void RefreshIfVisible(const std::vector<ClipboardEntry>& entries);
+    void RefreshIfVisible(const HistorySnapshot& entries);
 
     // Set callback for when user wants to restore an entry
     void SetRestoreCallback(RestoreCallback callback);
 
+    // Fill the list with older entries, not in the snapshot, when a search
+    // matches too few recent ones. They are looked up on search's worker
+    // thread and listed when OnColdSearchDone is called.
+    void SetColdSearch(ColdSearch* search);
+
+    // List the matches of the last cold search, if it is still the one the
+    // current filter asked for. Call on the window's thread.
+    void OnColdSearchDone();
+
 private:
     HWND m_hwnd;
     HWND m_searchEdit;
@@ -42,8 +53,13 @@ private:
     HBRUSH m_bgBrush;
     bool m_isVisible;
     RestoreCallback m_restoreCallback;
-    std::vector<ClipboardEntry> m_allEntries;
+    ColdSearch* m_coldSearch;
+    uint64_t m_coldTicket;                     // Search the current filter is waiting on, 0 if none
+    HistorySnapshot m_allEntries;
+    std::vector<ClipboardEntry> m_coldMatches; // Listed after the snapshot's entries
     std::wstring m_currentFilter;
+    SearchSession m_search;                    // Narrows the last matches as the filter grows
+    bool m_fuzzy;                              // Rank fuzzy matches instead (Ctrl+F toggles)
     WNDPROC m_oldEditProc;
     WNDPROC m_oldListViewProc;
     int m_selectedIndex;
@@ -65,5 +81,11 @@ private:
     void CreateControls();
     void UpdateListView();
     void FilterAndDisplay(const std::wstring& filter);
-    std::wstring GetEntryDisplayText(const ClipboardEntry& entry, int index);
+    void FitToItems(int itemCount);
+    void AddListItem(int row, LPARAM originalIndex, ClipboardDataType type, std::string_view text);
+
+    // The entry behind a list item's original index: the snapshot's entries
+    // first, then the cold matches
+    bool GetListedEntry(int originalIndex, ClipboardEntry& entry) const;
+    std::wstring GetEntryDisplayText(const HistoryItem& entry, int index);
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ClipboardHistory.h"
+#include "SpscQueue.h"
+#include "Storage.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Moves captured clipboard entries off the capture thread. The capture
+// callback only submits the entry to a lock-free queue; a consumer thread
+// adds it to the history (hashing, dedup) and queues it for storage, then
+// reports each drained batch once through the batch callback.
+class IngestPipeline {
+public:
+    using BatchCallback = std::function<void()>;
+
+    IngestPipeline(ClipboardHistory& history, Storage& storage, size_t capacity = 1024);
+    ~IngestPipeline();
+
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+    // Called on the consumer thread after each batch; set before Start
+    void SetBatchCallback(BatchCallback callback);
+
+    bool Start();
+
+    // Process everything submitted so far, then stop the consumer thread
+    void Stop();
+
+    // Hand an entry to the consumer. Call from a single capture thread.
+    // Never blocks; returns false (and drops the entry) if the queue is full.
+    bool Submit(ClipboardEntry entry);
+
+    // Block until every submitted entry has been processed
+    void Flush();
+
+private:
+    ClipboardHistory& m_history;
+    Storage& m_storage;
+    SpscQueue<ClipboardEntry> m_queue;
+    BatchCallback m_batchCallback;
+
+    std::thread m_consumer;
+    std::atomic<bool> m_stopping;
+
+    // Only taken to park and wake the consumer, and by Flush. Submit takes
+    // it only when the consumer is (about to be) asleep.
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::condition_variable m_drainedCv;
+    std::atomic<bool> m_sleeping;
+    std::atomic<uint64_t> m_submitted;
+    std::atomic<uint64_t> m_processed;
+
+    void ConsumerLoop();
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Long-lived read/write handle to an append-only log file.
+// Wraps a Win32 HANDLE on Windows and a file descriptor elsewhere.
+class LogFile {
+public:
+    LogFile();
+    ~LogFile();
+
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+
+    // Open (creating if needed) the file for reading and appending
+    bool Open(const std::wstring& path);
+    void Close();
+    bool IsOpen() const;
+
+    // Current size of the file in bytes
+    uint64_t Size() const;
+
+    // Append data at the end of the file in a single write
+    bool Append(const void* data, size_t size);
+
+    // Overwrite (or extend) the file at the given offset
+    bool WriteAt(uint64_t offset, const void* data, size_t size);
+
+    // Shrink or extend the file to the given size
+    bool Truncate(uint64_t size);
+
+    // Flush written data to stable storage
+    bool Sync();
+
+private:
+#ifdef _WIN32
+    void* m_handle;
+#else
+    int m_fd;
+#endif
+    uint64_t m_size;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "FileEngine.h"
+
+// The FileEngine log format, with every read served from the memory-mapped
+// view through the offset index instead of buffered file reads
+class MappedEngine : public FileEngine {
+public:
+    explicit MappedEngine(const std::wstring& path);
+
+    std::vector<ClipboardEntry> LoadLatest(size_t limit) override;
+    void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) override;
+};
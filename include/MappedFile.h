@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Read-only memory-mapped view of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file's current contents. Remapping picks up growth.
+    bool Map(const std::wstring& path);
+    void Unmap();
+    bool IsMapped() const;
+
+    const char* Data() const;
+    uint64_t Size() const;
+
+private:
+    const char* m_data;
+    uint64_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "StorageEngine.h"
+#include <mutex>
+#include <vector>
+
+// Keeps entries in memory only; nothing survives Close. For portable or
+// "don't write my clipboard to disk" setups, and as a baseline for the
+// on-disk engines.
+class MemoryEngine : public StorageEngine {
+public:
+    MemoryEngine();
+
+    bool Open() override;
+    void Close() override;
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override;
+    bool Sync() override;
+    std::vector<ClipboardEntry> LoadLatest(size_t limit) override;
+    void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) override;
+    bool ReadAt(size_t position, ClipboardEntry& entry) override;
+    bool FindByTime(std::chrono::system_clock::time_point time, size_t& position) override;
+    StorageStats GetStats() override;
+    bool Clear() override;
+    bool Compact(size_t retainEntries, double minSizeRatio) override;
+
+private:
+    std::mutex m_mutex;
+    std::vector<ClipboardEntry> m_entries; // Oldest first
+    StorageStats m_stats;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity circular buffer indexed newest first. Adding to a full
+// buffer overwrites the oldest item, so insert and evict are O(1) and items
+// never shift. Slots are allocated as the buffer fills, not up front, so a
+// large capacity costs nothing until it is used.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 0)
+        : m_capacity(capacity)
+        , m_start(0)
+        , m_size(0)
+    {
+    }
+
+    size_t Capacity() const { return m_capacity; }
+    size_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+
+    // Add an item as the newest. When the buffer is full the oldest item is
+    // moved into evicted (if given) and its slot reused. Returns whether an
+    // item was evicted.
+    bool PushFront(T item, T* evicted = nullptr) {
+        if (m_capacity == 0) {
+            return false;
+        }
+
+        if (m_size == m_capacity) {
+            T& slot = m_slots[m_start];
+            if (evicted) {
+                *evicted = std::move(slot);
+            }
+            slot = std::move(item);
+            m_start = Next(m_start);
+            return true;
+        }
+
+        if (m_size < m_slots.size()) {
+            m_slots[Physical(m_size)] = std::move(item);
+        } else {
+            // Growing the storage needs the items in order from slot 0
+            Linearize();
+            m_slots.push_back(std::move(item));
+        }
+        m_size++;
+        return false;
+    }
+
+    // Drop the oldest item
+    void PopBack() {
+        if (m_size == 0) {
+            return;
+        }
+        m_slots[m_start] = T();
+        m_start = Next(m_start);
+        m_size--;
+    }
+
+    // Items by age: 0 is the newest, Size() - 1 the oldest
+    T& operator[](size_t index) { return m_slots[Physical(m_size - 1 - index)]; }
+    const T& operator[](size_t index) const { return m_slots[Physical(m_size - 1 - index)]; }
+
+    T& Front() { return (*this)[0]; }
+    const T& Front() const { return (*this)[0]; }
+    T& Back() { return m_slots[m_start]; }
+    const T& Back() const { return m_slots[m_start]; }
+
+    // Remove every item matching pred, keeping the rest in order. O(n).
+    template <typename Pred>
+    size_t RemoveIf(Pred pred) {
+        Linearize();
+        auto end = std::remove_if(m_slots.begin(), m_slots.begin() + m_size, pred);
+        size_t removed = static_cast<size_t>((m_slots.begin() + m_size) - end);
+        for (auto it = end; it != m_slots.begin() + m_size; ++it) {
+            *it = T();
+        }
+        m_size -= removed;
+        return removed;
+    }
+
+    void Clear() {
+        m_slots.clear();
+        m_start = 0;
+        m_size = 0;
+    }
+
+    // Change the capacity, keeping the newest items. Growing is O(1);
+    // shrinking moves the kept items, it never copies them.
+    void SetCapacity(size_t capacity) {
+        while (m_size > capacity) {
+            PopBack();
+        }
+        if (capacity < m_slots.size()) {
+            Linearize();
+            m_slots.resize(m_size);
+        }
+        m_capacity = capacity;
+    }
+
+private:
+    std::vector<T> m_slots; // Grows to m_capacity as items are added
+    size_t m_capacity;
+    size_t m_start;         // Slot of the oldest item
+    size_t m_size;
+
+    // Slot of the item at the given distance from the oldest
+    size_t Physical(size_t fromOldest) const {
+        size_t slot = m_start + fromOldest;
+        return slot < m_slots.size() ? slot : slot - m_slots.size();
+    }
+
+    size_t Next(size_t slot) const {
+        return slot + 1 < m_slots.size() ? slot + 1 : 0;
+    }
+
+    // Move the items so the oldest is in slot 0 and unused slots are last
+    void Linearize() {
+        if (m_start == 0) {
+            return;
+        }
+        std::rotate(m_slots.begin(), m_slots.begin() + m_start, m_slots.end());
+        m_start = 0;
+    }
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ClipboardHistory.h"
+#include <string>
+#include <vector>
+
+// Incremental case-insensitive search over one history snapshot, for a
+// search box that re-queries on every keystroke. The matches for recent
+// queries are kept on a small stack. A query that contains an earlier one
+// (typing more) only rechecks that query's matches, and deleting characters
+// goes back to a result already on the stack, so a keystroke costs in
+// proportion to the matches rather than the history size. The history is
+// scanned in full only for a new snapshot or a query unrelated to the
+// stacked ones. Entries are matched on their folded text as stored, and
+// result buffers are reused, so a query does not allocate once they have
+// grown to size.
+class SearchSession {
+public:
+    SearchSession();
+
+    // Indexes into snapshot of the entries matching the UTF-8 query, newest
+    // first. Valid until the next call.
+    const std::vector<size_t>& Update(const HistorySnapshot& snapshot, const std::string& query);
+
+    // Forget the snapshot and every stacked result
+    void Reset();
+
+private:
+    struct Level {
+        std::string query; // Lowercase
+        std::vector<size_t> matches;
+    };
+
+    HistorySnapshot m_snapshot;
+    std::vector<Level> m_levels; // Every entry (empty query) first, newest query last
+    size_t m_depth;              // Levels in use; the rest keep their buffers
+    std::string m_lowerQuery;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "FileEngine.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The log split into FileEngine segments ("<path>.000001", ...), listed with
+// their time range and counters in "<path>.manifest". Appends go to the
+// newest segment, which is sealed and replaced once it reaches segmentBytes
+// or, with rotateDaily, when the (UTC) day changes. Retention drops whole
+// segments and rewrites at most the oldest one left, and reads only open the
+// segments they need.
+class SegmentedEngine : public StorageEngine {
+public:
+    explicit SegmentedEngine(const std::wstring& path, uint64_t segmentBytes = 8 * 1024 * 1024, bool rotateDaily = true);
+    ~SegmentedEngine() override;
+
+    SegmentedEngine(const SegmentedEngine&) = delete;
+    SegmentedEngine& operator=(const SegmentedEngine&) = delete;
+
+    bool Open() override;
+    void Close() override;
+    void SetRetention(std::chrono::hours maxAge, uint64_t maxBytes) override;
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override;
+    bool Sync() override;
+    std::vector<ClipboardEntry> LoadLatest(size_t limit) override;
+    void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) override;
+    bool ReadAt(size_t position, ClipboardEntry& entry) override;
+    bool FindByTime(std::chrono::system_clock::time_point time, size_t& position) override;
+    StorageStats GetStats() override;
+    bool Clear() override;
+
+    // Drops the oldest sealed segments that retention allows, and those not
+    // needed to keep retainEntries, then trims the oldest one left to the
+    // same limits. The segment being written is never dropped.
+    bool Compact(size_t retainEntries, double minSizeRatio) override;
+
+    // Segments with their files open, the one being written included
+    size_t GetOpenSegmentCount();
+
+private:
+    struct Segment {
+        uint64_t seq;
+        int64_t firstMs;     // Oldest and newest entry (ms since epoch)
+        int64_t lastMs;
+        StorageStats stats;
+        uint64_t diskBytes;
+        std::shared_ptr<FileEngine> engine; // Opened on first use
+        uint64_t lastUsed;                  // For closing idle sealed segments
+    };
+
+    std::wstring m_path;
+    uint64_t m_segmentBytes;
+    bool m_rotateDaily;
+
+    // m_mutex guards the segment list and retention settings. Readers
+    // share an opened segment through its shared_ptr, so one dropped or
+    // sealed meanwhile stays readable until they are done with it.
+    std::mutex m_mutex;
+    std::vector<Segment> m_segments; // Oldest first; the last is written to
+    std::chrono::hours m_maxAge;
+    uint64_t m_maxBytes;
+    uint64_t m_useCounter;
+
+    std::wstring SegmentPath(uint64_t seq) const;
+    std::wstring ManifestPath() const;
+
+    // Caller holds m_mutex for all of these
+    bool LoadManifest(bool& found);
+    bool SaveManifest();
+    std::shared_ptr<FileEngine> OpenSegment(Segment& segment);
+    void CloseIdleSegments();
+    void RefreshActive();
+    bool Rotate();
+    bool DropSegments(size_t count);
+
+    // Drop the oldest sealed segments that are empty, past the retention
+    // limits, or not needed to keep retainEntries, then trim the oldest
+    // remaining one to the entry and age limits
+    bool ApplyRetention(uint64_t retainEntries);
+    bool TrimSegment(Segment& segment, uint64_t keep);
+
+    // Make an existing single-file log the first segment
+    bool AdoptLog();
+};
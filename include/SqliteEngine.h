@@ -0,0 +1,51 @@
+#pragma once
+
+#include "StorageEngine.h"
+#include <mutex>
+#include <string>
+
+// Entries in a SQLite database in WAL mode. Needs a build with
+// CLIPPY2000_WITH_SQLITE; otherwise Open reports it unavailable.
+class SqliteEngine : public StorageEngine {
+public:
+    explicit SqliteEngine(const std::wstring& path);
+    ~SqliteEngine() override;
+
+    SqliteEngine(const SqliteEngine&) = delete;
+    SqliteEngine& operator=(const SqliteEngine&) = delete;
+
+    bool Open() override;
+    void Close() override;
+    void SetSyncPolicy(SyncPolicy policy) override;
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override;
+    bool Sync() override;
+    std::vector<ClipboardEntry> LoadLatest(size_t limit) override;
+    void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) override;
+    bool ReadAt(size_t position, ClipboardEntry& entry) override;
+    bool FindByTime(std::chrono::system_clock::time_point time, size_t& position) override;
+    StorageStats GetStats() override;
+    bool Clear() override;
+    bool Compact(size_t retainEntries, double minSizeRatio) override;
+
+private:
+    std::wstring m_path;
+    SyncPolicy m_syncPolicy;
+
+    // m_mutex guards the connection and statements, m_statsMutex the
+    // counters. Lock order: m_mutex before m_statsMutex.
+    std::mutex m_mutex;
+    void* m_db; // sqlite3* - using void* to avoid including sqlite3.h here
+    struct Statements;
+    Statements* m_sql; // Prepared statements cached for the life of m_db
+    std::mutex m_statsMutex;
+    StorageStats m_stats;
+
+    // Insert a batch in one transaction. Caller holds m_mutex.
+    bool Insert(const std::vector<ClipboardEntry>& batch);
+    bool InsertRow(const ClipboardEntry& entry);
+
+    // Import the flat log moved aside to importPath in one transaction,
+    // then delete it. Caller holds m_mutex.
+    bool ImportFlatLog(const std::wstring& importPath);
+    void CloseDatabase();
+};
@@ -1,32 +1,124 @@
 #pragma once
 
-#include "ClipboardHistory.h"
+#include "StorageEngine.h"
 #include <string>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 
+// Which StorageEngine Storage creates for a path
+enum class StorageBackend {
+    File,   // Append-only binary log with a sidecar offset index
+    Mapped, // Same log, read through the memory-mapped view only
+    Segmented, // The log split into size- or day-bounded segment files
+    Memory, // In memory only; nothing is written to disk
+    Sqlite  // SQLite database in WAL mode (needs a CLIPPY2000_WITH_SQLITE build)
+};
+
+// Queues entries for a background writer thread and hands them to a
+// StorageEngine in batches. Reads go straight to the engine.
 class Storage {
 public:
-    Storage(const std::wstring& dbPath = L"clippy2000.db");
+    Storage(const std::wstring& dbPath = L"clippy2000.db", StorageBackend backend = StorageBackend::File);
+    explicit Storage(std::unique_ptr<StorageEngine> engine);
     ~Storage();
 
-    // Initialize storage (create tables if needed)
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
+    // Open the engine and start the writer thread
     bool Initialize();
 
-    // Save a clipboard entry
+    // Set the fsync policy used by the writer thread
+    void SetSyncPolicy(SyncPolicy policy, unsigned intervalMs = 1000);
+
+    // Queue a clipboard entry for the writer thread. Never blocks on disk.
     bool SaveEntry(const ClipboardEntry& entry);
 
-    // Load all entries from storage
+    // Keep only the newest retainEntries. The writer thread compacts the
+    // engine when it grows past sizeRatio times what it retains, or after
+    // idleSeconds without writes once it holds half as much again.
+    void SetCompactionPolicy(size_t retainEntries, double sizeRatio = 4.0, unsigned idleSeconds = 300);
+
+    // Also drop history older than maxAgeDays, or past maxBytes on disk
+    // (0 = no limit). The segmented engine meets maxBytes by dropping whole
+    // segments, so it may keep up to one segment more than that.
+    void SetRetentionPolicy(unsigned maxAgeDays, uint64_t maxBytes = 0);
+
+    // Ask the writer thread to compact now
+    void RequestCompaction();
+
+    // Block until every queued entry has been written
+    void Flush();
+
+    // Drain queued entries, stop the writer thread and close the engine
+    void Shutdown();
+
+    // Load the newest entries from storage (newest first). Cost depends on
+    // limit, not on how much is stored.
     std::vector<ClipboardEntry> LoadEntries(size_t limit = 100);
 
+    // Visit every stored entry oldest first until visit returns false
+    void ForEachEntry(const std::function<bool(const ClipboardEntry&)>& visit);
+
     // Clear all entries
     bool ClearAll();
 
-    // Get entry count
+    // Get the number of entries written so far. O(1), no I/O.
     size_t GetCount();
 
+    // Get entry, byte and per-type totals for the written entries. O(1), no I/O.
+    StorageStats GetStats();
+
+    // Random access over everything stored, without loading earlier entries.
+    // Positions count from the newest entry (0) like LoadEntries.
+    bool ReadEntryAt(size_t position, ClipboardEntry& entry);
+
+    // Position of the newest entry captured at or before the given time
+    bool FindEntryByTime(std::chrono::system_clock::time_point time, size_t& position);
+
+    // Changes whenever entries are written, compacted or cleared, so
+    // positions may have moved. Odd while such a change is in progress;
+    // reads made between two equal, even versions saw one consistent state.
+    uint64_t GetVersion() const;
+
+    // Changes only when entries are compacted away or cleared. Appends leave
+    // it alone, so an entry's place counted from the oldest stored entry
+    // (GetCount() - 1 - position) holds until it changes.
+    uint64_t GetEpoch() const;
+
 private:
-    std::wstring m_dbPath;
-    void* m_db; // sqlite3* - using void* to avoid including sqlite3.h here
+    std::unique_ptr<StorageEngine> m_engine;
+
+    // Writer thread state. m_queueMutex guards the queue and flags.
+    std::thread m_writer;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCv;
+    std::condition_variable m_drainedCv;
+    std::vector<ClipboardEntry> m_queue;
+    bool m_writing;
+    bool m_stopping;
+    std::atomic<bool> m_unsynced;
+    SyncPolicy m_syncPolicy;
+    std::chrono::milliseconds m_syncInterval;
+    size_t m_retainEntries;
+    double m_compactRatio;
+    std::chrono::seconds m_compactIdle;
+    bool m_compactRequested;
+
+    // Held while the engine's entries change, so version bumps pair up
+    std::mutex m_changeMutex;
+    std::atomic<uint64_t> m_version;
+    std::atomic<uint64_t> m_epoch;
+
+    // Writer thread: swaps out the queue and writes it as one batch
+    void WriterLoop();
+    void WriteBatch(const std::vector<ClipboardEntry>& batch, bool syncAfter);
+    void SyncFile();
 
-    bool CreateTables();
+    // Keep the newest retainEntries. Skipped unless the engine holds at
+    // least minSizeRatio times that.
+    bool CompactLog(size_t retainEntries, double minSizeRatio);
 };
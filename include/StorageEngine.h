@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ClipboardHistory.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// When appended entries are flushed to stable storage
+enum class SyncPolicy {
+    None,       // Leave flushing to the OS
+    PerBatch,   // Sync after every batch written
+    Interval    // Sync at most once per interval while there are unsynced writes
+};
+
+// Running totals an engine keeps current, so they are available without I/O
+struct StorageStats {
+    uint64_t entryCount = 0;
+    uint64_t payloadBytes = 0;   // Payload bytes as stored, excluding framing
+                                 // (a deduplicated entry counts only its blob reference)
+    uint64_t typeCounts[3] = {}; // Indexed by ClipboardDataType
+};
+
+// Where Storage keeps its entries. Engines are called from the writer thread
+// (Append, Sync, Compact) and from readers at the same time, so every method
+// must be safe to call concurrently once Open has returned.
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+
+    // Open (creating if needed) the underlying store
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+
+    // How durable Append and Sync need to be; set before Open
+    virtual void SetSyncPolicy(SyncPolicy policy) { (void)policy; }
+
+    // How much history to keep beyond what Compact retains: entries older
+    // than maxAge and the oldest entries past maxBytes may be dropped.
+    // Zero means no limit. Engines that cannot drop cheaply ignore it.
+    virtual void SetRetention(std::chrono::hours maxAge, uint64_t maxBytes) { (void)maxAge; (void)maxBytes; }
+
+    // Append entries oldest first as one batch, syncing afterwards if asked
+    virtual bool Append(const std::vector<ClipboardEntry>& batch, bool sync) = 0;
+    virtual bool Sync() = 0;
+
+    // The newest entries, newest first
+    virtual std::vector<ClipboardEntry> LoadLatest(size_t limit) = 0;
+
+    // Visit every entry oldest first until visit returns false
+    virtual void ForEach(const std::function<bool(const ClipboardEntry&)>& visit) = 0;
+
+    // Random access by position from the newest entry (0), and the position
+    // of the newest entry captured at or before a given time
+    virtual bool ReadAt(size_t position, ClipboardEntry& entry) = 0;
+    virtual bool FindByTime(std::chrono::system_clock::time_point time, size_t& position) = 0;
+
+    virtual StorageStats GetStats() = 0;
+    virtual bool Clear() = 0;
+
+    // Keep only the newest retainEntries. Skipped unless the store has grown
+    // to at least minSizeRatio times what it would retain (0 forces it).
+    virtual bool Compact(size_t retainEntries, double minSizeRatio) = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for many small UTF-8 strings. Text is copied into
+// large chunks and referred to by chunk, offset and length, so storing a
+// string does not allocate once a chunk has room. Each chunk counts the bytes
+// still in use; a chunk with none left is dropped, and kept for reuse if no
+// snapshot still holds it.
+//
+// Not thread-safe; the owner serializes access.
+class TextArena {
+public:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t live = 0;
+    };
+
+    struct Ref {
+        uint32_t chunk = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    explicit TextArena(size_t chunkBytes = 64 * 1024);
+
+    TextArena(const TextArena&) = delete;
+    TextArena& operator=(const TextArena&) = delete;
+
+    // Copy text into the arena
+    Ref Store(std::string_view text);
+
+    // The stored text. Valid until the reference is released, or for as
+    // long as a pinned chunk is held.
+    std::string_view View(const Ref& ref) const;
+
+    // Give up a reference; its chunk is dropped once nothing in it is live
+    void Release(const Ref& ref);
+
+    void Clear();
+
+    // Every chunk in use, so a reader can keep their text alive
+    std::vector<std::shared_ptr<const Chunk>> Pin() const;
+
+    // Bytes referenced, and bytes held in chunks (live or not)
+    size_t LiveBytes() const { return m_liveBytes; }
+    size_t UsedBytes() const { return m_usedBytes; }
+
+    size_t ChunkBytes() const { return m_chunkBytes; }
+
+private:
+    size_t m_chunkBytes;
+    std::vector<std::shared_ptr<Chunk>> m_chunks; // Indexed by Ref::chunk; null when free
+    std::vector<uint32_t> m_freeIds;
+    std::vector<std::shared_ptr<Chunk>> m_spare;  // Emptied chunks kept for reuse
+    uint32_t m_current;                           // Chunk being filled
+    bool m_hasCurrent;
+    size_t m_liveBytes;
+    size_t m_usedBytes;
+
+    void StartChunk(size_t minBytes);
+    void Retire(uint32_t id);
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+class TextEncoding {
+public:
+    // Convert wide text (UTF-16 on Windows, UTF-32 elsewhere) to UTF-8
+    static std::string WideToUtf8(const std::wstring& text);
+    static std::string WideToUtf8(const wchar_t* data, size_t size);
+
+    // Convert UTF-8 to wide text; invalid sequences become U+FFFD
+    static std::wstring Utf8ToWide(const char* data, size_t size);
+    static std::wstring Utf8ToWide(const std::string& text);
+
+    // Lowercase UTF-8 text into out, for case-insensitive matching. ASCII is
+    // lowered byte by byte; other characters go through towlower. Invalid
+    // bytes are copied unchanged.
+    static void LowerCase(std::string_view text, std::string& out);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+class TextSearch {
+public:
+    // Offset of the first occurrence of needle in text, or npos. Compares
+    // bytes exactly; search case-folded text (TextEncoding::LowerCase) for a
+    // case-insensitive match. Skips from one occurrence of the needle's
+    // rarest byte to the next while they are far apart, then checks 32 or 16
+    // positions at a time on its two rarest bytes with AVX2 or SSE2 when the
+    // CPU has them. Text too short to repay ranking the needle's bytes is
+    // filtered on its first and last bytes instead; Pattern ranks them once.
+    static size_t Find(std::string_view text, std::string_view needle);
+
+    static bool Contains(std::string_view text, std::string_view needle) {
+        return Find(text, needle) != std::string_view::npos;
+    }
+
+    // A needle prepared for searching many texts: the ranking of its bytes
+    // is done once instead of on every Find. It refers to the needle's
+    // bytes, which must outlive it.
+    class Pattern {
+    public:
+        explicit Pattern(std::string_view needle);
+
+        size_t Find(std::string_view text) const;
+
+        bool Contains(std::string_view text) const {
+            return Find(text) != std::string_view::npos;
+        }
+
+    private:
+        std::string_view m_needle;
+        size_t m_rare1; // Positions of its rarest and next rarest bytes
+        size_t m_rare2;
+    };
+
+    // The implementations Find chooses between once the rarest byte turns
+    // out to be common, so tests and benchmarks can compare them. Scalar is
+    // std::string_view::find.
+    enum class Method { Scalar, Sse2, Avx2 };
+
+    // Whether this build and CPU can run method
+    static bool IsSupported(Method method);
+
+    // Find with a given method; it must be supported
+    static size_t FindWith(Method method, std::string_view text, std::string_view needle);
+};
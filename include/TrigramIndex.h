@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Inverted index from each three-byte sequence (trigram) of a text to the
+// ids of the texts containing it. A text containing a query contains every
+// trigram of the query, so intersecting the query's lists narrows a search
+// to a few candidates, which the caller then checks.
+//
+// Ids must be added in increasing order. Each list stores the gaps between
+// its ids as varints, usually a byte or two per id. Nothing is ever
+// removed: callers skip ids that are gone and rebuild the index once those
+// pile up.
+//
+// Not thread-safe; the owner serializes access.
+class TrigramIndex {
+public:
+    // The distinct trigrams of text, sorted, into keys
+    static void Trigrams(std::string_view text, std::vector<uint32_t>& keys);
+
+    // Add an id, larger than any added before, under each key
+    void Add(uint64_t id, const std::vector<uint32_t>& keys);
+
+    // Ids under every key, ascending. Lists much longer than the result so
+    // far are not decoded, so some ids may lack a key; callers check every
+    // candidate anyway.
+    void Find(const std::vector<uint32_t>& keys, std::vector<uint64_t>& ids) const;
+
+    // Length of the shortest list among keys, to judge whether Find is
+    // worth it before decoding anything
+    size_t ShortestList(const std::vector<uint32_t>& keys) const;
+
+    // Remove every id. Lists keep their buffers, so indexing the same kind
+    // of text again does not allocate.
+    void Clear();
+
+    // Free the lists nothing was added to since Clear, once they are half
+    // of all lists
+    void DropEmpty();
+
+    // Bytes held by the lists
+    size_t Bytes() const { return m_bytes; }
+
+private:
+    struct Postings {
+        std::vector<uint8_t> gaps; // Varint gaps, the first from 0
+        uint64_t last = 0;
+        size_t count = 0;
+    };
+
+    std::unordered_map<uint32_t, Postings> m_postings;
+    size_t m_bytes = 0;
+};
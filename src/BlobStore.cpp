@@ -0,0 +1,492 @@
+#include "BlobStore.h"
+#include "Compression.h"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+const char kBlobMagic[4] = { 'C', 'L', 'P', 'B' };
+const uint32_t kBlobVersion = 2;
+const size_t kBlobHeaderSize = 16;
+const size_t kBlobRecordHeaderSize = 16;
+const size_t kBlobRecordHeaderSizeV1 = 12;
+
+// Saved blob table ("<path>.idx")
+const char kTableMagic[4] = { 'C', 'L', 'P', 'T' };
+const uint32_t kTableVersion = 1;
+const size_t kTableHeaderSize = 32;
+const size_t kTableEntrySize = 24;
+
+// Below this, LZ4 rarely saves enough to pay for decompressing on read
+const size_t kMinCompressSize = 256;
+
+// Rewrite flushes the new store whenever this much is buffered
+const size_t kRewriteChunkBytes = 1 << 22;
+
+void PutU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+void PutU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+uint32_t GetU32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+           (static_cast<uint32_t>(u[2]) << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+uint64_t GetU64(const char* p) {
+    return static_cast<uint64_t>(GetU32(p)) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+std::string EncodeHeader(uint64_t storeId) {
+    std::string header(kBlobMagic, sizeof(kBlobMagic));
+    PutU32(header, kBlobVersion);
+    PutU64(header, storeId);
+    return header;
+}
+
+uint64_t NewStoreId() {
+    std::random_device random;
+    uint64_t id = (static_cast<uint64_t>(random()) << 32) ^ random();
+    id ^= static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    return id != 0 ? id : 1;
+}
+
+} // namespace
+
+BlobStore::BlobStore()
+    : m_storeId(0)
+    , m_tableCount(0)
+    , m_tableStale(false)
+{
+}
+
+BlobStore::~BlobStore() {
+    Close();
+}
+
+bool BlobStore::Open(const std::wstring& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    m_blobs.clear();
+    m_pending.clear();
+    m_table.Unmap();
+    m_tableCount = 0;
+    m_tableStale = false;
+
+    // Leftovers from an interrupted rewrite or table save
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::path(path + L".compact"), ec);
+    std::filesystem::remove(std::filesystem::path(path + L".idx.compact"), ec);
+
+    if (!m_file.Open(path)) {
+        return false;
+    }
+    if (m_file.Size() == 0) {
+        return CreateStore();
+    }
+
+    if (!m_map.Map(path) || m_map.Size() < kBlobHeaderSize ||
+        !std::equal(kBlobMagic, kBlobMagic + sizeof(kBlobMagic), m_map.Data())) {
+        // Not a blob store we can read; start over rather than guess
+        return CreateStore();
+    }
+
+    uint32_t version = GetU32(m_map.Data() + 4);
+    if (version > kBlobVersion) {
+        std::wcerr << L"Blob store " << path << L" was written by a newer version" << std::endl;
+        m_map.Unmap();
+        m_file.Close();
+        return false;
+    }
+    m_storeId = GetU64(m_map.Data() + 8);
+
+    // Cut off a torn final record
+    uint64_t end = LoadTable(version == 1 ? kBlobRecordHeaderSizeV1 : kBlobRecordHeaderSize);
+    if (end < m_map.Size()) {
+        m_map.Unmap();
+        m_file.Truncate(end);
+    }
+
+    if (version < kBlobVersion && !Rewrite(false)) {
+        std::wcerr << L"Failed to upgrade blob store " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BlobStore::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file.IsOpen() && m_tableStale && !SaveTable()) {
+        std::wcerr << L"Failed to save the blob table of " << m_path << std::endl;
+    }
+    m_map.Unmap();
+    m_table.Unmap();
+    m_tableCount = 0;
+    m_file.Close();
+    m_blobs.clear();
+    m_pending.clear();
+}
+
+bool BlobStore::Reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return CreateStore();
+}
+
+bool BlobStore::CreateStore() {
+    // Caller holds m_mutex. The new id retires any saved table.
+    m_map.Unmap();
+    m_table.Unmap();
+    m_tableCount = 0;
+    m_tableStale = true;
+    m_blobs.clear();
+    m_pending.clear();
+    m_storeId = NewStoreId();
+    std::string header = EncodeHeader(m_storeId);
+    return m_file.Truncate(0) && m_file.Append(header.data(), header.size());
+}
+
+uint64_t BlobStore::LoadTable(size_t recordHeaderSize) {
+    // Caller holds m_mutex and has mapped the store
+    const char* data = m_map.Data();
+    uint64_t size = m_map.Size();
+    uint64_t offset = kBlobHeaderSize;
+
+    // The table is trusted if it was saved for this store id and the store
+    // still holds the bytes it covers; the store only grows until its id
+    // changes. Version 1 stores never had one.
+    if (recordHeaderSize == kBlobRecordHeaderSize && m_table.Map(m_path + L".idx")) {
+        const char* table = m_table.Data();
+        uint64_t tableSize = m_table.Size();
+        if (tableSize >= kTableHeaderSize && std::equal(kTableMagic, kTableMagic + sizeof(kTableMagic), table) &&
+            GetU32(table + 4) == kTableVersion && GetU64(table + 8) == m_storeId &&
+            GetU64(table + 16) >= kBlobHeaderSize && GetU64(table + 16) <= size &&
+            (tableSize - kTableHeaderSize) % kTableEntrySize == 0) {
+            m_tableCount = static_cast<size_t>((tableSize - kTableHeaderSize) / kTableEntrySize);
+            offset = GetU64(table + 16);
+        } else {
+            m_table.Unmap();
+        }
+    }
+    m_tableStale = !m_table.IsMapped();
+
+    // Walk the records appended after the table was saved
+    while (offset + recordHeaderSize <= size) {
+        uint32_t blobSize = GetU32(data + offset + 8);
+        uint32_t rawSize = recordHeaderSize == kBlobRecordHeaderSizeV1 ? blobSize : GetU32(data + offset + 12);
+        if (offset + recordHeaderSize + blobSize > size) {
+            break;
+        }
+        Blob blob = { offset + recordHeaderSize, blobSize, rawSize, 0 };
+        m_blobs.emplace(GetU64(data + offset), blob);
+        m_tableStale = true;
+        offset += recordHeaderSize + blobSize;
+    }
+    return offset;
+}
+
+bool BlobStore::SaveTable() {
+    // Caller holds m_mutex. Merge the saved table with m_blobs, leaving out
+    // blobs still staged for Commit, and write it sorted by hash.
+    uint64_t committed = m_file.Size();
+    std::vector<std::pair<uint64_t, Blob>> entries;
+    entries.reserve(m_tableCount + m_blobs.size());
+    for (size_t i = 0; i < m_tableCount; i++) {
+        const char* entry = m_table.Data() + kTableHeaderSize + i * kTableEntrySize;
+        if (m_blobs.find(GetU64(entry)) == m_blobs.end()) {
+            entries.push_back({ GetU64(entry), { GetU64(entry + 8), GetU32(entry + 16), GetU32(entry + 20), 0 } });
+        }
+    }
+    for (const auto& item : m_blobs) {
+        if (item.second.offset < committed) {
+            entries.push_back(item);
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const std::pair<uint64_t, Blob>& a, const std::pair<uint64_t, Blob>& b) { return a.first < b.first; });
+
+    std::string buffer(kTableMagic, sizeof(kTableMagic));
+    PutU32(buffer, kTableVersion);
+    PutU64(buffer, m_storeId);
+    PutU64(buffer, committed);
+    PutU64(buffer, 0);
+    for (const auto& item : entries) {
+        PutU64(buffer, item.first);
+        PutU64(buffer, item.second.offset);
+        PutU32(buffer, item.second.size);
+        PutU32(buffer, item.second.rawSize);
+    }
+
+    std::wstring tablePath = m_path + L".idx";
+    std::wstring tempPath = tablePath + L".compact";
+    LogFile temp;
+    bool ok = temp.Open(tempPath) && temp.Truncate(0) && temp.Append(buffer.data(), buffer.size()) && temp.Sync();
+    temp.Close();
+
+    // Windows cannot replace a file that is mapped
+    m_table.Unmap();
+    m_tableCount = 0;
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(std::filesystem::path(tempPath), std::filesystem::path(tablePath), ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(std::filesystem::path(tempPath), ec);
+        return false;
+    }
+
+    if (m_table.Map(tablePath) && m_table.Size() == buffer.size()) {
+        m_tableCount = entries.size();
+    } else {
+        m_table.Unmap();
+    }
+    m_tableStale = false;
+    return true;
+}
+
+BlobStore::Blob* BlobStore::Find(uint64_t hash) {
+    // Caller holds m_mutex
+    auto it = m_blobs.find(hash);
+    if (it != m_blobs.end()) {
+        return &it->second;
+    }
+    if (m_tableCount == 0) {
+        return nullptr;
+    }
+
+    const char* entries = m_table.Data() + kTableHeaderSize;
+    size_t low = 0;
+    size_t high = m_tableCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (GetU64(entries + mid * kTableEntrySize) < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    const char* entry = entries + low * kTableEntrySize;
+    if (low == m_tableCount || GetU64(entry) != hash) {
+        return nullptr;
+    }
+    Blob blob = { GetU64(entry + 8), GetU32(entry + 16), GetU32(entry + 20), 0 };
+    return &m_blobs.emplace(hash, blob).first->second;
+}
+
+bool BlobStore::AddRef(uint64_t hash, const std::string& data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Blob* existing = Find(hash);
+    if (existing) {
+        std::string stored;
+        if (existing->rawSize != data.size() || !ReadBlob(*existing, stored) || stored != data) {
+            return false;
+        }
+        existing->refs++;
+        return true;
+    }
+
+    // Keep the compressed form only when it is actually smaller
+    std::string compressed;
+    if (data.size() >= kMinCompressSize) {
+        compressed = Compression::Lz4Compress(data.data(), data.size());
+    }
+    const std::string& stored = !compressed.empty() && compressed.size() < data.size() ? compressed : data;
+
+    Blob blob = { m_file.Size() + m_pending.size() + kBlobRecordHeaderSize,
+                  static_cast<uint32_t>(stored.size()), static_cast<uint32_t>(data.size()), 1 };
+    PutU64(m_pending, hash);
+    PutU32(m_pending, blob.size);
+    PutU32(m_pending, blob.rawSize);
+    m_pending.append(stored);
+    m_blobs.emplace(hash, blob);
+    m_tableStale = true;
+    return true;
+}
+
+void BlobStore::AddRef(uint64_t hash) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Blob* blob = Find(hash);
+    if (blob) {
+        blob->refs++;
+    }
+}
+
+void BlobStore::Release(uint64_t hash) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Blob* blob = Find(hash);
+    if (blob && blob->refs > 0) {
+        blob->refs--;
+    }
+}
+
+void BlobStore::ClearRefs() {
+    // Blobs only in the saved table were never referenced here
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& item : m_blobs) {
+        item.second.refs = 0;
+    }
+}
+
+bool BlobStore::Commit() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.empty()) {
+        return true;
+    }
+    if (!m_file.Append(m_pending.data(), m_pending.size())) {
+        return false;
+    }
+    m_pending.clear();
+    return true;
+}
+
+bool BlobStore::Sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.Sync();
+}
+
+bool BlobStore::Read(uint64_t hash, std::string& data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Blob* blob = Find(hash);
+    return blob && ReadBlob(*blob, data);
+}
+
+uint64_t BlobStore::Size() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.Size() + m_pending.size();
+}
+
+const char* BlobStore::Locate(const Blob& blob) {
+    // Caller holds m_mutex
+    uint64_t committed = m_file.Size();
+    if (blob.offset >= committed) {
+        return m_pending.data() + (blob.offset - committed);
+    }
+
+    // Remap when the store has grown past the view
+    uint64_t end = blob.offset + blob.size;
+    if (!m_map.IsMapped() || m_map.Size() < end) {
+        if (!m_map.Map(m_path) || m_map.Size() < end) {
+            return nullptr;
+        }
+    }
+    return m_map.Data() + blob.offset;
+}
+
+bool BlobStore::ReadBlob(const Blob& blob, std::string& data) {
+    // Caller holds m_mutex
+    const char* stored = Locate(blob);
+    if (!stored) {
+        return false;
+    }
+    if (blob.size == blob.rawSize) {
+        data.assign(stored, blob.size);
+        return true;
+    }
+    return Compression::Lz4Decompress(stored, blob.size, blob.rawSize, data);
+}
+
+bool BlobStore::Compact() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pending.empty()) {
+        return false;
+    }
+
+    // Blobs only in the saved table have no references
+    size_t live = 0;
+    for (const auto& item : m_blobs) {
+        live += item.second.refs > 0 ? 1 : 0;
+    }
+    size_t total = m_blobs.size();
+    for (size_t i = 0; i < m_tableCount; i++) {
+        total += m_blobs.count(GetU64(m_table.Data() + kTableHeaderSize + i * kTableEntrySize)) == 0 ? 1 : 0;
+    }
+    if (live == total) {
+        return true;
+    }
+    return Rewrite(true);
+}
+
+bool BlobStore::Rewrite(bool dropUnreferenced) {
+    // Caller holds m_mutex. Copy the blobs to keep into a new file, then
+    // rename it over the old one. Until the rename the old store stays complete.
+    // The copy is written in bounded chunks, never held in memory whole.
+    for (size_t i = 0; i < m_tableCount; i++) {
+        Find(GetU64(m_table.Data() + kTableHeaderSize + i * kTableEntrySize));
+    }
+
+    std::wstring tempPath = m_path + L".compact";
+    LogFile temp;
+    bool ok = temp.Open(tempPath) && temp.Truncate(0);
+
+    uint64_t storeId = NewStoreId();
+    std::string buffer = EncodeHeader(storeId);
+    std::unordered_map<uint64_t, Blob> kept;
+    for (auto it = m_blobs.begin(); ok && it != m_blobs.end(); ++it) {
+        if (dropUnreferenced && it->second.refs == 0) {
+            continue;
+        }
+        const char* stored = Locate(it->second);
+        if (!stored) {
+            ok = false;
+            break;
+        }
+        Blob moved = { temp.Size() + buffer.size() + kBlobRecordHeaderSize, it->second.size, it->second.rawSize,
+                       it->second.refs };
+        PutU64(buffer, it->first);
+        PutU32(buffer, it->second.size);
+        PutU32(buffer, it->second.rawSize);
+        buffer.append(stored, it->second.size);
+        kept.emplace(it->first, moved);
+
+        if (buffer.size() >= kRewriteChunkBytes) {
+            ok = temp.Append(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    ok = ok && temp.Append(buffer.data(), buffer.size()) && temp.Sync();
+    temp.Close();
+
+    std::error_code ec;
+    if (!ok) {
+        std::filesystem::remove(std::filesystem::path(tempPath), ec);
+        return false;
+    }
+
+    // Windows cannot replace a file that is open or mapped
+    m_map.Unmap();
+    m_file.Close();
+    std::filesystem::rename(std::filesystem::path(tempPath), std::filesystem::path(m_path), ec);
+    bool swapped = !ec;
+    if (swapped) {
+        // Every blob was copied out of the old table, whose offsets are gone
+        m_blobs.swap(kept);
+        m_storeId = storeId;
+        m_table.Unmap();
+        m_tableCount = 0;
+    } else {
+        std::filesystem::remove(std::filesystem::path(tempPath), ec);
+    }
+
+    if (!m_file.Open(m_path)) {
+        std::wcerr << L"Failed to reopen blob store after rewriting it" << std::endl;
+        return false;
+    }
+
+    if (swapped && !SaveTable()) {
+        m_tableStale = true;
+    }
+    return swapped;
+}
@@ -1,93 +1,745 @@
 #include "ClipboardHistory.h"
+#include "BlobStore.h"
+#include "FuzzyMatch.h"
+#include "Hash.h"
+#include "Storage.h"
+#include "TextEncoding.h"
+#include "TextSearch.h"
 #include <algorithm>
-#include <cctype>
+
+namespace {
+
+// Spare ring slots for the dead ones promotion leaves behind. Compacting
+// costs O(n) and happens at most once per this many promotions.
+size_t SpareSlots(size_t maxEntries) {
+    return maxEntries / 4 + 16;
+}
+
+// Text kept in memory for a spilled entry: enough to show and search
+const size_t kPreviewBytes = 4096;
+
+// Attempts to read a cold page while storage keeps changing under it
+const int kColdPageAttempts = 3;
+
+// Released spill blobs tolerated before the store is compacted, on top of
+// one per live blob
+const size_t kSpillSlack = 16;
+
+// Evicted ids tolerated in the trigram index before it is rebuilt, on top
+// of one per live entry
+const size_t kStaleIdSlack = 64;
+
+// The index is used when the query's rarest trigram is in at most this
+// share of the entries; past that a snapshot scan is about as fast and
+// does not hold the lock
+const size_t kIndexedShare = 4;
+
+// Key for an entry id in m_ids. Ids are consecutive, and as keys of their
+// own would fill one long probe run; this mix is one-to-one, so distinct
+// ids still never share a key.
+uint64_t IdKey(uint64_t id) {
+    id ^= id >> 30;
+    id *= 0xBF58476D1CE4E5B9ULL;
+    id ^= id >> 27;
+    id *= 0x94D049BB133111EBULL;
+    id ^= id >> 31;
+    return id;
+}
+
+uint64_t HashText(const std::string& text) {
+    return Hash::XXH64(text.data(), text.size());
+}
+
+// Length of the preview of a spilled text, cut at a character boundary
+size_t PreviewLength(const std::string& text) {
+    size_t length = std::min(text.size(), kPreviewBytes);
+    while (length > 0 && length < text.size() && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+        length--;
+    }
+    return length;
+}
+
+} // namespace
 
 ClipboardHistory::ClipboardHistory(size_t maxEntries)
-    : m_maxEntries(maxEntries)
+    : m_slots(maxEntries + SpareSlots(maxEntries))
+    , m_maxEntries(maxEntries)
+    , m_maxBytes(0)
+    , m_bytes(0)
+    , m_dead(0)
+    , m_spill(nullptr)
+    , m_spillBytes(0)
+    , m_spillLive(0)
+    , m_spillReleased(0)
+    , m_nextSeq(0)
+    , m_nextId(0)
+    , m_staleIds(0)
+    , m_version(0)
+    , m_storage(nullptr)
+    , m_pageEntries(0)
+    , m_coldCacheBytes(0)
+    , m_coldBytes(0)
+    , m_coldEpoch(0)
 {
-    m_entries.reserve(maxEntries);
 }
 
-void ClipboardHistory::AddEntry(const std::wstring& text, ClipboardDataType type) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void ClipboardHistory::AddEntry(const std::string& text, ClipboardDataType type) {
+    AddEntry(ClipboardEntry(text, type));
+}
 
+void ClipboardHistory::AddEntry(ClipboardEntry entry) {
     // Ignore empty text
-    if (text.empty()) {
+    if (entry.text.empty()) {
         return;
     }
 
-    // Check for duplicate (don't add if same as most recent)
-    if (IsDuplicate(text)) {
+    // Hash, and write a large body to the spill store, before taking the
+    // lock; only the index lookup needs the hash
+    uint64_t hash = HashText(entry.text);
+    bool spilled = m_spill && entry.text.size() >= m_spillBytes && entry.text.size() > kPreviewBytes &&
+                   m_spill->AddRef(hash, entry.text);
+    if (spilled) {
+        m_spill->Commit();
+    }
+
+    // Fold the text kept in memory once here, so searches can match it as
+    // is, and list its trigrams for the index. The buffers are per thread
+    // so steady-state ingest does not allocate for them.
+    size_t keptBytes = spilled ? PreviewLength(entry.text) : entry.text.size();
+    std::string_view kept(entry.text.data(), keptBytes);
+    thread_local std::string folded;
+    thread_local std::vector<uint32_t> trigrams;
+    TextEncoding::LowerCase(kept, folded);
+    TrigramIndex::Trigrams(folded, trigrams);
+    bool foldedIsText = folded == kept;
+    size_t textBytes = foldedIsText ? keptBytes : keptBytes + folded.size();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_maxEntries == 0 || (m_maxBytes > 0 && EntryBytes(textBytes) > m_maxBytes)) {
+        if (spilled) {
+            ReleaseSpill(hash);
+        }
         return;
     }
 
-    // Add new entry at the beginning (newest first)
-    m_entries.insert(m_entries.begin(), ClipboardEntry(text, type));
+    Slot slot;
+    slot.type = entry.type;
+    slot.timestamp = entry.timestamp;
+    slot.size = entry.text.size();
+    slot.hash = hash;
+    slot.spilled = spilled;
+    slot.live = true;
+
+    uint64_t seq;
+    bool promoted = Find(entry.text, hash, spilled, seq);
+    if (promoted) {
+        // The entry already holds a reference to its spilled body
+        if (spilled) {
+            ReleaseSpill(hash);
+        }
+
+        // Already the most recent entry
+        if (seq == m_nextSeq - 1) {
+            return;
+        }
+
+        // Promote: the text moves to the new slot as is, and a dead slot is
+        // left where the entry was
+        Slot& old = m_slots[static_cast<size_t>(m_nextSeq - 1 - seq)];
+        slot.text = old.text;
+        slot.folded = old.folded;
+        slot.foldedIsText = old.foldedIsText;
+        slot.id = old.id;
+        slot.spilled = old.spilled;
+        old.live = false;
+        m_dead++;
+        m_index.Erase(hash, seq);
+        m_ids.Erase(IdKey(slot.id), seq);
+        m_bytes -= EntryBytes(SlotTextBytes(slot));
+    }
+
+    if (m_slots.Size() == m_slots.Capacity()) {
+        Compact();
+    }
+
+    if (!promoted) {
+        slot.text = m_text.Store(kept);
+        slot.foldedIsText = foldedIsText;
+        if (!foldedIsText) {
+            slot.folded = m_text.Store(folded);
+        }
+        slot.id = m_nextId++;
+        m_trigrams.Add(slot.id, trigrams);
+        if (spilled) {
+            m_spillLive++;
+        }
+    }
+    m_bytes += EntryBytes(SlotTextBytes(slot));
+    uint64_t id = slot.id;
+    m_slots.PushFront(std::move(slot));
+    m_index.Insert(hash, m_nextSeq);
+    m_ids.Insert(IdKey(id), m_nextSeq);
+    m_nextSeq++;
+    Trim();
+
+    if (m_staleIds > m_slots.Size() - m_dead + kStaleIdSlack) {
+        RebuildTrigrams();
+    }
 
-    // Remove oldest entry if we exceed max size
-    if (m_entries.size() > m_maxEntries) {
-        m_entries.pop_back();
+    // Promotions keep old chunks partly live; copy the text out once they
+    // hold more garbage than live text
+    if (TextFragmented()) {
+        Compact();
+    }
+    m_version++;
+}
+
+bool HistorySnapshot::GetEntry(size_t index, ClipboardEntry& entry) const {
+    const HistoryItem& item = m_data->items[index];
+    entry.type = item.type;
+    entry.timestamp = item.timestamp;
+    if (!item.spilled) {
+        entry.text.assign(item.text.data(), item.text.size());
+        return true;
     }
+    return m_data->spill->Read(item.hash, entry.text);
 }
 
-std::vector<ClipboardEntry> ClipboardHistory::GetEntries() const {
+HistorySnapshot ClipboardHistory::GetSnapshot() const {
+    HistorySnapshot snapshot;
+    snapshot.m_data = std::atomic_load(&m_snapshot);
+    if (snapshot.m_data && snapshot.m_data->version == m_version) {
+        return snapshot;
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
-    return m_entries;
+    snapshot.m_data = std::atomic_load(&m_snapshot);
+    uint64_t version = m_version;
+    if (snapshot.m_data && snapshot.m_data->version == version) {
+        return snapshot;
+    }
+
+    auto data = std::make_shared<HistorySnapshot::Data>();
+    data->version = version;
+    data->spill = m_spill;
+    data->items.reserve(m_slots.Size() - m_dead);
+    for (size_t i = 0; i < m_slots.Size(); i++) {
+        const Slot& slot = m_slots[i];
+        if (slot.live) {
+            data->items.push_back({ slot.type, m_text.View(slot.text), FoldedText(slot), slot.timestamp, slot.size,
+                                    slot.hash, slot.spilled });
+        }
+    }
+    data->chunks = m_text.Pin();
+    snapshot.m_data = data;
+    std::atomic_store(&m_snapshot, snapshot.m_data);
+    return snapshot;
 }
 
 size_t ClipboardHistory::GetCount() const {
     std::lock_guard<std::mutex> lock(m_mutex);
-    return m_entries.size();
+    return m_slots.Size() - m_dead;
 }
 
 void ClipboardHistory::Clear() {
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_entries.clear();
+    m_slots.Clear();
+    m_index.Clear();
+    m_ids.Clear();
+    m_trigrams.Clear();
+    m_trigrams.DropEmpty();
+    m_staleIds = 0;
+    m_text.Clear();
+    m_bytes = 0;
+    m_dead = 0;
+    if (m_spill) {
+        m_spill->Reset();
+    }
+    m_spillLive = 0;
+    m_spillReleased = 0;
+    m_version++;
 }
 
 void ClipboardHistory::SetMaxEntries(size_t maxEntries) {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_maxEntries = maxEntries;
 
-    // Trim if current size exceeds new max
-    if (m_entries.size() > m_maxEntries) {
-        m_entries.resize(m_maxEntries);
+    // Keeps the newest entries if the history is over the new max
+    Compact();
+    Trim();
+    m_slots.SetCapacity(maxEntries + SpareSlots(maxEntries));
+    m_version++;
+}
+
+void ClipboardHistory::SetMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBytes = maxBytes;
+    Trim();
+    m_version++;
+}
+
+void ClipboardHistory::SetSpillStore(BlobStore* store, size_t spillBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spill = store;
+    m_spillBytes = spillBytes;
+    m_spillLive = 0;
+    m_spillReleased = 0;
+    if (m_spill) {
+        m_spill->Reset();
+    }
+}
+
+size_t ClipboardHistory::GetBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+size_t ClipboardHistory::EntryBytes(size_t textBytes) {
+    // Text in the arena, the ring slot, the snapshot item, and a share of
+    // the index table (24-byte slots, kept at most half full)
+    return textBytes + sizeof(Slot) + sizeof(HistoryItem) + 48;
+}
+
+size_t ClipboardHistory::SlotTextBytes(const Slot& slot) {
+    return slot.foldedIsText ? slot.text.length : slot.text.length + slot.folded.length;
+}
+
+void ClipboardHistory::ReleaseText(const Slot& slot) {
+    m_text.Release(slot.text);
+    if (!slot.foldedIsText) {
+        m_text.Release(slot.folded);
+    }
+}
+
+std::string_view ClipboardHistory::FoldedText(const Slot& slot) const {
+    return m_text.View(slot.foldedIsText ? slot.text : slot.folded);
+}
+
+void ClipboardHistory::RebuildTrigrams() {
+    // Ids have to go back in increasing order, which is not recency order
+    // once entries have been promoted
+    thread_local std::vector<std::pair<uint64_t, size_t>> live;
+    live.clear();
+    for (size_t i = 0; i < m_slots.Size(); i++) {
+        if (m_slots[i].live) {
+            live.emplace_back(m_slots[i].id, i);
+        }
+    }
+    std::sort(live.begin(), live.end());
+
+    m_trigrams.Clear();
+    thread_local std::vector<uint32_t> trigrams;
+    for (const auto& entry : live) {
+        TrigramIndex::Trigrams(FoldedText(m_slots[entry.second]), trigrams);
+        m_trigrams.Add(entry.first, trigrams);
     }
+    m_trigrams.DropEmpty();
+    m_staleIds = 0;
 }
 
-bool ClipboardHistory::IsDuplicate(const std::wstring& text) const {
-    // Check if the text matches the most recent entry
-    if (!m_entries.empty() && m_entries.front().text == text) {
+bool ClipboardHistory::Find(const std::string& text, uint64_t hash, bool spilled, uint64_t& seq) const {
+    return m_index.ForEach(hash, [&](uint64_t candidate) {
+        const Slot& slot = m_slots[static_cast<size_t>(m_nextSeq - 1 - candidate)];
+        if (slot.size != text.size() || (slot.spilled ? !spilled : m_text.View(slot.text) != text)) {
+            return false;
+        }
+        seq = candidate;
         return true;
+    });
+}
+
+void ClipboardHistory::ReleaseSpill(uint64_t hash) {
+    m_spill->Release(hash);
+    if (++m_spillReleased > m_spillLive + kSpillSlack) {
+        m_spill->Compact();
+        m_spillReleased = 0;
     }
-    return false;
 }
 
-std::vector<ClipboardEntry> ClipboardHistory::Search(const std::wstring& query) const {
+void ClipboardHistory::Compact() {
+    if (m_dead > 0) {
+        m_slots.RemoveIf([](const Slot& slot) { return !slot.live; });
+        m_dead = 0;
+
+        // Surviving slots moved, so their sequence numbers change
+        m_index.Clear();
+        m_ids.Clear();
+        for (size_t i = 0; i < m_slots.Size(); i++) {
+            m_index.Insert(m_slots[i].hash, m_nextSeq - 1 - i);
+            m_ids.Insert(IdKey(m_slots[i].id), m_nextSeq - 1 - i);
+        }
+    }
+
+    if (TextFragmented()) {
+        // Copy the live text into fresh chunks, newest first. Old chunks are
+        // recycled as they empty; snapshots still holding one keep it until
+        // they are released.
+        for (size_t i = 0; i < m_slots.Size(); i++) {
+            Slot& slot = m_slots[i];
+            TextArena::Ref moved = m_text.Store(m_text.View(slot.text));
+            TextArena::Ref movedFolded = slot.foldedIsText ? moved : m_text.Store(m_text.View(slot.folded));
+            ReleaseText(slot);
+            slot.text = moved;
+            slot.folded = movedFolded;
+        }
+    }
+}
+
+bool ClipboardHistory::TextFragmented() const {
+    return m_text.UsedBytes() - m_text.LiveBytes() > m_text.LiveBytes() + m_text.ChunkBytes();
+}
+
+void ClipboardHistory::Trim() {
+    while (!m_slots.Empty() && (m_slots.Size() - m_dead > m_maxEntries ||
+                                (m_maxBytes > 0 && m_bytes > m_maxBytes) || !m_slots.Back().live)) {
+        Slot& oldest = m_slots.Back();
+        if (oldest.live) {
+            m_index.Erase(oldest.hash, m_nextSeq - m_slots.Size());
+            m_ids.Erase(IdKey(oldest.id), m_nextSeq - m_slots.Size());
+            m_staleIds++;
+            ReleaseText(oldest);
+            m_bytes -= EntryBytes(SlotTextBytes(oldest));
+            if (oldest.spilled) {
+                m_spillLive--;
+                ReleaseSpill(oldest.hash);
+            }
+        } else {
+            m_dead--;
+        }
+        m_slots.PopBack();
+    }
+}
+
+void ClipboardHistory::SetColdStorage(Storage* storage, size_t pageEntries, size_t cacheBytes) {
+    std::lock_guard<std::mutex> lock(m_coldMutex);
+    m_storage = storage;
+    m_pageEntries = std::max<size_t>(pageEntries, 1);
+    m_coldCacheBytes = cacheBytes;
+    m_coldPages.clear();
+    m_coldBytes = 0;
+    m_coldEpoch = storage ? storage->GetEpoch() : 0;
+}
+
+std::vector<ClipboardEntry> ClipboardHistory::SearchCold(const std::string& query, size_t maxResults, size_t maxScanned,
+                                                         const std::function<bool()>& cancelled) const {
+    std::vector<ClipboardEntry> results;
+    std::lock_guard<std::mutex> lock(m_coldMutex);
+    if (!m_storage || maxResults == 0) {
+        return results;
+    }
+
+    std::string lowerQuery;
+    TextEncoding::LowerCase(query, lowerQuery);
+    TextSearch::Pattern pattern(lowerQuery);
+    std::string lowerText;
+
+    for (int attempt = 0; attempt < kColdPageAttempts; attempt++) {
+        results.clear();
+        size_t next;
+        uint64_t epoch;
+        if (!GetColdRange(next, epoch)) {
+            continue;
+        }
+
+        // Walk back from the newest cold entry a page at a time. Texts seen
+        // in this search, and texts in memory, are repeats. Stored text is
+        // only read once an entry is known not to repeat one seen here, and
+        // stays loaded in the cached page.
+        HashIndex seen;
+        size_t scanned = 0;
+        bool moved = false;
+        while (next > 0 && results.size() < maxResults && (maxScanned == 0 || scanned < maxScanned)) {
+            if (cancelled && cancelled()) {
+                return results;
+            }
+            size_t number = (next - 1) / m_pageEntries;
+            ColdPage* page = GetColdPage(number, next - number * m_pageEntries);
+            if (!page || m_coldEpoch != epoch) {
+                moved = true;
+                break;
+            }
+            for (; next > number * m_pageEntries && results.size() < maxResults &&
+                   (maxScanned == 0 || scanned < maxScanned); next--, scanned++) {
+                size_t offset = next - 1 - number * m_pageEntries;
+                ClipboardEntry& entry = page->entries[offset];
+                uint64_t hash = page->hashes[offset];
+                size_t size = entry.TextSize();
+                if (seen.ForEach(hash, [size](uint64_t other) { return other == size; })) {
+                    continue;
+                }
+                seen.Insert(hash, size);
+                entry.LoadText();
+                if (IsHot(entry.text, hash)) {
+                    continue;
+                }
+                TextEncoding::LowerCase(entry.text, lowerText);
+                if (pattern.Contains(lowerText)) {
+                    results.push_back(entry);
+                }
+            }
+        }
+
+        // Compaction renumbered the entries partway through; start over
+        if (!moved) {
+            break;
+        }
+    }
+    return results;
+}
+
+size_t ClipboardHistory::ColdStart() const {
+    std::chrono::system_clock::time_point oldest;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_slots.Empty()) {
+            return 0;
+        }
+        // Trim never leaves a dead slot last
+        oldest = m_slots.Back().timestamp;
+    }
+
+    // Storage keeps milliseconds, so step back one to skip the oldest hot
+    // entry's own record
+    size_t position;
+    if (!m_storage->FindEntryByTime(oldest - std::chrono::milliseconds(1), position)) {
+        return m_storage->GetCount();
+    }
+    return position;
+}
+
+bool ClipboardHistory::GetColdRange(size_t& cold, uint64_t& epoch) const {
+    uint64_t version = m_storage->GetVersion();
+    size_t start = ColdStart();
+    size_t count = m_storage->GetCount();
+    epoch = m_storage->GetEpoch();
+    if ((version & 1) != 0 || m_storage->GetVersion() != version) {
+        return false;
+    }
+    cold = start < count ? count - start : 0;
+    return true;
+}
+
+ClipboardHistory::ColdPage* ClipboardHistory::GetColdPage(size_t number, size_t minEntries) const {
+    for (int attempt = 0; attempt < kColdPageAttempts; attempt++) {
+        uint64_t version = m_storage->GetVersion();
+        uint64_t epoch = m_storage->GetEpoch();
+        if (epoch != m_coldEpoch) {
+            m_coldPages.clear();
+            m_coldBytes = 0;
+            m_coldEpoch = epoch;
+        }
+
+        for (auto it = m_coldPages.begin(); it != m_coldPages.end(); ++it) {
+            if (it->number != number) {
+                continue;
+            }
+            if (it->entries.size() >= minEntries) {
+                m_coldPages.splice(m_coldPages.begin(), m_coldPages, it);
+                return &m_coldPages.front();
+            }
+            // The newest page, read before the entries now wanted were stored
+            m_coldBytes -= it->bytes;
+            m_coldPages.erase(it);
+            break;
+        }
+
+        ColdPage page;
+        page.number = number;
+        page.bytes = 0;
+        size_t count = m_storage->GetCount();
+        size_t first = number * m_pageEntries;
+        for (size_t index = first; index < first + m_pageEntries && index < count; index++) {
+            ClipboardEntry entry;
+            if (!m_storage->ReadEntryAt(count - 1 - index, entry)) {
+                break;
+            }
+            page.bytes += sizeof(ClipboardEntry) + sizeof(uint64_t) + entry.TextSize();
+            page.hashes.push_back(entry.stored ? entry.stored->Hash() : HashText(entry.text));
+            page.entries.push_back(std::move(entry));
+        }
+
+        // Positions moved while the page was read; try again
+        if ((version & 1) != 0 || m_storage->GetVersion() != version) {
+            continue;
+        }
+        if (page.entries.size() < minEntries) {
+            return nullptr;
+        }
+
+        m_coldBytes += page.bytes;
+        m_coldPages.push_front(std::move(page));
+
+        // Evict least recently used pages, always keeping the one just read
+        while (m_coldBytes > m_coldCacheBytes && m_coldPages.size() > 1) {
+            m_coldBytes -= m_coldPages.back().bytes;
+            m_coldPages.pop_back();
+        }
+        return &m_coldPages.front();
+    }
+    return nullptr;
+}
+
+bool ClipboardHistory::IsHot(const std::string& text, uint64_t hash) const {
+    // Spilled entries match on hash and size; the rest compare their text
     std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t seq;
+    return Find(text, hash, true, seq);
+}
+
+bool ClipboardHistory::SearchIndexed(const std::string& lowerQuery, const std::vector<uint32_t>& trigrams,
+                                     std::vector<ClipboardEntry>& results) const {
+    std::vector<std::pair<size_t, uint64_t>> spilled; // Result index, body hash
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_trigrams.ShortestList(trigrams) > (m_slots.Size() - m_dead) / kIndexedShare) {
+            return false;
+        }
+
+        // Check each candidate that is still live, then put the matches
+        // back in recency order
+        std::vector<uint64_t> ids;
+        m_trigrams.Find(trigrams, ids);
+        TextSearch::Pattern pattern(lowerQuery);
+        std::vector<uint64_t> matches;
+        for (uint64_t id : ids) {
+            m_ids.ForEach(IdKey(id), [&](uint64_t seq) {
+                const Slot& slot = m_slots[static_cast<size_t>(m_nextSeq - 1 - seq)];
+                if (pattern.Contains(FoldedText(slot))) {
+                    matches.push_back(seq);
+                }
+                return true;
+            });
+        }
+        std::sort(matches.begin(), matches.end(), [](uint64_t a, uint64_t b) { return a > b; });
+
+        results.reserve(matches.size());
+        for (uint64_t seq : matches) {
+            const Slot& slot = m_slots[static_cast<size_t>(m_nextSeq - 1 - seq)];
+            ClipboardEntry entry;
+            entry.type = slot.type;
+            entry.timestamp = slot.timestamp;
+            if (slot.spilled) {
+                spilled.emplace_back(results.size(), slot.hash);
+            } else {
+                std::string_view text = m_text.View(slot.text);
+                entry.text.assign(text.data(), text.size());
+            }
+            results.push_back(std::move(entry));
+        }
+    }
+
+    // Large bodies are read without the lock; one released meanwhile drops
+    // its entry, as HistorySnapshot::GetEntry would
+    bool missing = false;
+    for (const auto& body : spilled) {
+        if (!m_spill->Read(body.second, results[body.first].text)) {
+            results[body.first].text.clear();
+            missing = true;
+        }
+    }
+    if (missing) {
+        results.erase(std::remove_if(results.begin(), results.end(),
+                                     [](const ClipboardEntry& entry) { return entry.text.empty(); }),
+                      results.end());
+    }
+    return true;
+}
+
+std::vector<ClipboardEntry> ClipboardHistory::Search(const std::string& query) const {
     std::vector<ClipboardEntry> results;
 
     if (query.empty()) {
-        return m_entries;
+        HistorySnapshot snapshot = GetSnapshot();
+        for (size_t i = 0; i < snapshot.Size(); i++) {
+            ClipboardEntry entry;
+            if (snapshot.GetEntry(i, entry)) {
+                results.push_back(std::move(entry));
+            }
+        }
+        return results;
     }
 
     // Convert query to lowercase for case-insensitive search
-    std::wstring lowerQuery = query;
-    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(),
-        [](wchar_t c) { return towlower(c); });
+    std::string lowerQuery;
+    TextEncoding::LowerCase(query, lowerQuery);
+
+    std::vector<uint32_t> trigrams;
+    TrigramIndex::Trigrams(lowerQuery, trigrams);
+    if (!trigrams.empty() && SearchIndexed(lowerQuery, trigrams, results)) {
+        return results;
+    }
 
-    // Search through entries
-    for (const auto& entry : m_entries) {
-        // Convert entry text to lowercase
-        std::wstring lowerText = entry.text;
-        std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(),
-            [](wchar_t c) { return towlower(c); });
+    // Search through entries, newest first, matching their folded text as
+    // stored. Spilled entries are matched on their preview.
+    HistorySnapshot snapshot = GetSnapshot();
+    TextSearch::Pattern pattern(lowerQuery);
+    for (size_t i = 0; i < snapshot.Size(); i++) {
+        const HistoryItem& item = snapshot[i];
 
         // Check if query is found in the text
-        if (lowerText.find(lowerQuery) != std::wstring::npos) {
-            results.push_back(entry);
+        ClipboardEntry entry;
+        if (pattern.Contains(item.folded) && snapshot.GetEntry(i, entry)) {
+            results.push_back(std::move(entry));
         }
     }
 
     return results;
 }
+
+std::vector<ClipboardEntry> ClipboardHistory::SearchFuzzy(const std::string& query, size_t maxResults) const {
+    HistorySnapshot snapshot = GetSnapshot();
+    std::vector<ClipboardEntry> results;
+    for (size_t index : RankFuzzy(snapshot, query, maxResults)) {
+        ClipboardEntry entry;
+        if (snapshot.GetEntry(index, entry)) {
+            results.push_back(std::move(entry));
+        }
+    }
+    return results;
+}
+
+std::vector<size_t> ClipboardHistory::RankFuzzy(const HistorySnapshot& snapshot, const std::string& query, size_t maxResults) {
+    std::vector<size_t> ranked;
+    if (maxResults == 0) {
+        return ranked;
+    }
+
+    std::string pattern;
+    TextEncoding::LowerCase(query, pattern);
+
+    // The best matches so far, with the worst of them on top of the heap, so
+    // a match that does not make the cut costs one comparison. Entries come
+    // newest first, so a later one never displaces an equal score.
+    struct Match {
+        int score;
+        size_t index;
+    };
+    auto better = [](const Match& a, const Match& b) { return a.score != b.score ? a.score > b.score : a.index < b.index; };
+    std::vector<Match> heap;
+    heap.reserve(std::min(maxResults, snapshot.Size()));
+
+    // Spilled entries are matched on their preview
+    for (size_t i = 0; i < snapshot.Size(); i++) {
+        const HistoryItem& item = snapshot[i];
+        Match match;
+        if (!FuzzyMatch::Score(item.text, item.folded, pattern, match.score)) {
+            continue;
+        }
+        match.index = i;
+        if (heap.size() < maxResults) {
+            heap.push_back(match);
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(match, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = match;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), better);
+    ranked.reserve(heap.size());
+    for (const Match& match : heap) {
+        ranked.push_back(match.index);
+    }
+    return ranked;
+}
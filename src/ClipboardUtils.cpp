@@ -1,11 +1,13 @@
 #include "ClipboardUtils.h"
+#include "TextEncoding.h"
 #include <windows.h>
 #include <shellapi.h>
 #include <shlobj.h>
 #include <iostream>
 #include <vector>
 
-bool ClipboardUtils::SetClipboardText(const std::wstring& text) {
+bool ClipboardUtils::SetClipboardText(const std::string& utf8Text) {
+    std::wstring text = TextEncoding::Utf8ToWide(utf8Text);
     if (!OpenClipboard(nullptr)) {
         return false;
     }
@@ -31,17 +33,17 @@ bool ClipboardUtils::SetClipboardText(const std::wstring& text) {
     return true;
 }
 
-std::wstring ClipboardUtils::GetClipboardText() {
+std::string ClipboardUtils::GetClipboardText() {
     if (!OpenClipboard(nullptr)) {
-        return L"";
+        return "";
     }
 
-    std::wstring text;
+    std::string text;
     HANDLE hData = GetClipboardData(CF_UNICODETEXT);
     if (hData != nullptr) {
         wchar_t* pszText = static_cast<wchar_t*>(GlobalLock(hData));
         if (pszText != nullptr) {
-            text = pszText;
+            text = TextEncoding::WideToUtf8(pszText, wcslen(pszText));
             GlobalUnlock(hData);
         }
     }
@@ -50,9 +52,9 @@ std::wstring ClipboardUtils::GetClipboardText() {
     return text;
 }
 
-std::wstring ClipboardUtils::GetClipboardFiles() {
+std::string ClipboardUtils::GetClipboardFiles() {
     if (!OpenClipboard(nullptr)) {
-        return L"";
+        return "";
     }
 
     std::wstring result;
@@ -73,7 +75,7 @@ std::wstring ClipboardUtils::GetClipboardFiles() {
     }
 
     CloseClipboard();
-    return result;
+    return TextEncoding::WideToUtf8(result);
 }
 
 ClipboardDataType ClipboardUtils::GetClipboardDataType() {
@@ -111,7 +113,8 @@ bool ClipboardUtils::RestoreEntry(const ClipboardEntry& entry) {
     }
 }
 
-bool ClipboardUtils::RestoreFilesToClipboard(const std::wstring& filePaths) {
+bool ClipboardUtils::RestoreFilesToClipboard(const std::string& utf8Paths) {
+    std::wstring filePaths = TextEncoding::Utf8ToWide(utf8Paths);
     if (!OpenClipboard(nullptr)) {
         return false;
     }
@@ -0,0 +1,104 @@
+#include "ColdSearch.h"
+
+ColdSearch::ColdSearch(const ClipboardHistory& history, size_t maxScanned)
+    : m_history(history)
+    , m_maxScanned(maxScanned)
+    , m_stopping(false)
+    , m_requested(0)
+    , m_maxResults(0)
+    , m_started(0)
+    , m_finished(0)
+{
+}
+
+ColdSearch::~ColdSearch() {
+    Stop();
+}
+
+void ColdSearch::SetDoneCallback(DoneCallback callback) {
+    m_doneCallback = callback;
+}
+
+bool ColdSearch::Start() {
+    if (m_worker.joinable()) {
+        return true;
+    }
+    m_stopping = false;
+    m_worker = std::thread(&ColdSearch::WorkerLoop, this);
+    return true;
+}
+
+void ColdSearch::Stop() {
+    if (!m_worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_requested++; // Stops a running search
+    }
+    m_wakeCv.notify_one();
+    m_worker.join();
+}
+
+uint64_t ColdSearch::Request(const std::string& query, size_t maxResults) {
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ticket = ++m_requested;
+        m_query = query;
+        m_maxResults = maxResults;
+        m_finished = 0;
+        m_results.clear();
+    }
+    m_wakeCv.notify_one();
+    return ticket;
+}
+
+void ColdSearch::Cancel() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_started = ++m_requested;
+    m_finished = 0;
+    m_results.clear();
+}
+
+bool ColdSearch::TakeResults(uint64_t ticket, std::vector<ClipboardEntry>& results) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (ticket == 0 || m_finished != ticket) {
+        return false;
+    }
+    results.swap(m_results);
+    m_results.clear();
+    m_finished = 0;
+    return true;
+}
+
+void ColdSearch::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wakeCv.wait(lock, [this]() { return m_stopping || m_started != m_requested; });
+        if (m_stopping) {
+            break;
+        }
+        uint64_t ticket = m_requested;
+        std::string query = m_query;
+        size_t maxResults = m_maxResults;
+        m_started = ticket;
+        lock.unlock();
+
+        std::vector<ClipboardEntry> results = m_history.SearchCold(query, maxResults, m_maxScanned,
+            [this, ticket]() { return m_requested != ticket; });
+
+        lock.lock();
+        if (m_requested != ticket) {
+            continue;
+        }
+        m_finished = ticket;
+        m_results.swap(results);
+        if (m_doneCallback) {
+            lock.unlock();
+            m_doneCallback();
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "Compression.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t kMinMatch = 4;
+const size_t kLastLiterals = 5;   // A block always ends with at least this many literals
+const size_t kMatchFindLimit = 12; // No match may start this close to the end
+const size_t kMaxOffset = 65535;
+const int kHashBits = 12;
+
+uint32_t Read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t HashSequence(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// Write a length that did not fit in its 4-bit token field
+void PutLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+void PutSequence(std::string& out, const unsigned char* literals, size_t literalLength,
+                 size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength >= kMinMatch ? matchLength - kMinMatch : 0;
+    unsigned char token = static_cast<unsigned char>(
+        ((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) {
+        PutLength(out, literalLength - 15);
+    }
+    out.append(reinterpret_cast<const char*>(literals), literalLength);
+
+    // The final sequence carries literals only
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>((offset >> 8) & 0xFF));
+    if (matchCode >= 15) {
+        PutLength(out, matchCode - 15);
+    }
+}
+
+// Read an extended length; returns false if it runs past end
+bool GetLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (p >= end) {
+            return false;
+        }
+        byte = *p++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+std::string Compression::Lz4Compress(const char* data, size_t size) {
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(data);
+    std::string out;
+    out.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+    if (size >= kMatchFindLimit + 1) {
+        // Positions are stored plus one so zero means empty
+        std::vector<uint32_t> table(static_cast<size_t>(1) << kHashBits, 0);
+        size_t matchLimit = size - kLastLiterals;
+        size_t pos = 0;
+
+        while (pos < size - kMatchFindLimit) {
+            uint32_t sequence = Read32(src + pos);
+            uint32_t& slot = table[HashSequence(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+
+            if (candidate == 0 || pos - (candidate - 1) > kMaxOffset || Read32(src + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+            candidate--;
+
+            size_t length = kMinMatch;
+            while (pos + length < matchLimit && src[candidate + length] == src[pos + length]) {
+                length++;
+            }
+
+            PutSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    PutSequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool Compression::Lz4Decompress(const char* data, size_t size, size_t rawSize, std::string& out) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    out.assign(rawSize, '\0');
+    char* dst = rawSize > 0 ? &out[0] : nullptr;
+    size_t written = 0;
+
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !GetLength(p, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(end - p) || literalLength > rawSize - written) {
+            return false;
+        }
+        if (literalLength > 0) {
+            std::memcpy(dst + written, p, literalLength);
+        }
+        written += literalLength;
+        p += literalLength;
+
+        if (p == end) {
+            break; // Final, literal-only sequence
+        }
+
+        if (end - p < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8);
+        p += 2;
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !GetLength(p, end, matchLength)) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if (offset == 0 || offset > written || matchLength > rawSize - written) {
+            return false;
+        }
+
+        // A match may overlap the bytes it is producing; copy those one at a time
+        const char* from = dst + written - offset;
+        if (offset >= matchLength) {
+            std::memcpy(dst + written, from, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                dst[written + i] = from[i];
+            }
+        }
+        written += matchLength;
+    }
+
+    return written == rawSize;
+}
@@ -0,0 +1,1050 @@
+#include "FileEngine.h"
+#include "Hash.h"
+#include "TextEncoding.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <random>
+
+// StorageEngine over an append-only binary log.
+//
+// File layout (all integers little-endian):
+//   Header (64 bytes): magic "CLPY", u32 version, u32 header size, u32 reserved,
+//                      u64 log id (new for every fresh or compacted log),
+//                      u64 committed size, u64 entry count, u64 payload bytes,
+//                      u32 text / image / files counts, u32 reserved
+//   Record:            u32 payload size, u8 type, u8 flags, u16 reserved,
+//                      i64 timestamp (ms since epoch), UTF-8 payload,
+//                      u32 CRC-32C of everything before it in the record,
+//                      u32 total record size (so the log can be walked from either end)
+//
+// On Open the records past the header's committed size, which a crash may
+// have left half written, are checked against their CRC, as is the record
+// ending at the committed size. The log is cut at the first record that
+// fails, and what was dropped is reported. Records before that were checked
+// when they were committed; readers still check each CRC as they decode.
+// Version 1 logs (no CRC) are rewritten in this format when opened.
+//
+// Payloads of kMinBlobSize bytes or more go to the "<path>.blobs" store
+// instead, once per distinct payload. Their records carry kRecordBlobRef and
+// a 12-byte payload: u64 XXH64 of the UTF-8 text, u32 text size. Blobs are
+// written before the records that reference them. Reference counts are not
+// kept between compactions: compaction counts the references of the records
+// it retains and drops the blobs none of them reference.
+//
+// A sidecar "<path>.idx" file holds the offset and timestamp of every record,
+// so the memory-mapped read path can reach any entry by position or time
+// without parsing the records before it.
+//
+// The header counters are rewritten after every batch together with the
+// committed size they cover. If the file is longer than that (a crash between
+// the two writes), the records past it are counted again on Open.
+//
+// Files written by earlier versions (one "timestamp|type|text" line per entry)
+// are converted to this format the first time they are opened.
+
+
+namespace {
+
+const char kFileMagic[4] = { 'C', 'L', 'P', 'Y' };
+const uint32_t kFormatVersion = 2;
+const size_t kFileHeaderSize = 64;
+const size_t kRecordHeaderSize = 16;
+const size_t kRecordTrailerSize = 8;
+const size_t kRecordOverhead = kRecordHeaderSize + kRecordTrailerSize;
+
+// Version 1 records end with the size alone
+const size_t kRecordOverheadV1 = kRecordHeaderSize + 4;
+
+// Record flags
+const uint8_t kRecordBlobRef = 0x01;
+const size_t kBlobRefSize = 12;
+
+// Shorter payloads are cheaper to repeat inline than to reference
+const size_t kMinBlobSize = 64;
+
+// Sidecar index: 16-byte header ("CLPI", u32 version, u64 id of the log it
+// describes), then one 16-byte entry per record: u64 record offset,
+// i64 timestamp (ms since epoch)
+const char kIndexMagic[4] = { 'C', 'L', 'P', 'I' };
+const uint32_t kIndexVersion = 1;
+const size_t kIndexHeaderSize = 16;
+const size_t kIndexEntrySize = 16;
+
+// Compaction is not worth a rewrite until the log reaches this size
+const uint64_t kMinCompactionBytes = 64 * 1024;
+
+void PutU16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value & 0xFF));
+    out.push_back(static_cast<char>((value >> 8) & 0xFF));
+}
+
+void PutU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+void PutU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+uint32_t GetU32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+           (static_cast<uint32_t>(u[2]) << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+uint64_t GetU64(const char* p) {
+    return static_cast<uint64_t>(GetU32(p)) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+ClipboardDataType ToDataType(int value) {
+    switch (value) {
+        case static_cast<int>(ClipboardDataType::Files): return ClipboardDataType::Files;
+        case static_cast<int>(ClipboardDataType::Image): return ClipboardDataType::Image;
+        default: return ClipboardDataType::Text;
+    }
+}
+
+std::string EncodeIndexHeader(uint64_t logId) {
+    std::string header(kIndexMagic, sizeof(kIndexMagic));
+    PutU32(header, kIndexVersion);
+    PutU64(header, logId);
+    return header;
+}
+
+std::string EncodeFileHeader(uint64_t logId, const StorageStats& stats, uint64_t committedSize) {
+    std::string header(kFileMagic, sizeof(kFileMagic));
+    PutU32(header, kFormatVersion);
+    PutU32(header, static_cast<uint32_t>(kFileHeaderSize));
+    PutU32(header, 0);
+    PutU64(header, logId);
+    PutU64(header, committedSize);
+    PutU64(header, stats.entryCount);
+    PutU64(header, stats.payloadBytes);
+    for (uint64_t count : stats.typeCounts) {
+        PutU32(header, static_cast<uint32_t>(count));
+    }
+    header.resize(kFileHeaderSize, '\0');
+    return header;
+}
+
+// Returns the committed size the header's counters cover
+uint64_t DecodeFileCounters(const std::string& header, StorageStats& stats) {
+    if (header.size() < kFileHeaderSize) {
+        return 0;
+    }
+    stats.entryCount = GetU64(header.data() + 32);
+    stats.payloadBytes = GetU64(header.data() + 40);
+    for (size_t i = 0; i < 3; i++) {
+        stats.typeCounts[i] = GetU32(header.data() + 48 + i * 4);
+    }
+    return GetU64(header.data() + 24);
+}
+
+// Add the record whose header is given to stats
+void CountRecord(StorageStats& stats, const char* recordHeader) {
+    size_t type = static_cast<size_t>(ToDataType(static_cast<unsigned char>(recordHeader[4])));
+    stats.entryCount++;
+    stats.payloadBytes += GetU32(recordHeader);
+    stats.typeCounts[type]++;
+}
+
+// Identifies one incarnation of the log so a sidecar index left over from
+// before a clear or compaction is never mistaken for the current one
+uint64_t NewLogId() {
+    std::random_device random;
+    uint64_t id = (static_cast<uint64_t>(random()) << 32) ^ random();
+    id ^= static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    return id != 0 ? id : 1;
+}
+
+int64_t ToEpochMillis(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point FromEpochMillis(int64_t ms) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(ms)));
+}
+
+// Append one encoded record to out. With a blob store, large payloads are
+// added to it and the record only references them.
+void EncodeRecord(const ClipboardEntry& source, std::string& out, BlobStore* blobs = nullptr) {
+    // An entry read from another store may not have loaded its text yet
+    ClipboardEntry loaded;
+    if (source.stored) {
+        loaded = source;
+        loaded.LoadText();
+    }
+    const ClipboardEntry& entry = source.stored ? loaded : source;
+
+    std::string_view payload = entry.text;
+    std::string blobRef;
+    size_t start = out.size();
+    uint8_t flags = 0;
+
+    if (blobs && payload.size() >= kMinBlobSize) {
+        uint64_t hash = Hash::XXH64(payload.data(), payload.size());
+        if (blobs->AddRef(hash, entry.text)) {
+            flags |= kRecordBlobRef;
+            PutU64(blobRef, hash);
+            PutU32(blobRef, static_cast<uint32_t>(payload.size()));
+            payload = blobRef;
+        }
+    }
+
+    PutU32(out, static_cast<uint32_t>(payload.size()));
+    out.push_back(static_cast<char>(entry.type));
+    out.push_back(static_cast<char>(flags));
+    PutU16(out, 0); // reserved
+    PutU64(out, static_cast<uint64_t>(ToEpochMillis(entry.timestamp)));
+    out.append(payload);
+    PutU32(out, Hash::Crc32c(out.data() + start, out.size() - start));
+    PutU32(out, static_cast<uint32_t>(payload.size() + kRecordOverhead));
+}
+
+// True if the recordSize bytes at data end in a matching size and CRC
+bool CheckRecord(const char* data, size_t recordSize) {
+    const char* trailer = data + recordSize - kRecordTrailerSize;
+    return GetU32(trailer + 4) == recordSize &&
+           GetU32(trailer) == Hash::Crc32c(data, recordSize - kRecordTrailerSize);
+}
+
+// True if a complete record ends at end, or end is where records start
+bool EndsRecord(const char* data, uint64_t end) {
+    if (end == kFileHeaderSize) {
+        return true;
+    }
+    uint64_t recordSize = GetU32(data + end - 4);
+    return end >= kFileHeaderSize + kRecordOverhead && recordSize >= kRecordOverhead &&
+           recordSize <= end - kFileHeaderSize && CheckRecord(data + end - recordSize, static_cast<size_t>(recordSize));
+}
+
+// Re-encode version 1 records (no CRC) in the current format, counting them
+// into stats. Stops at the first incomplete record.
+std::string UpgradeRecords(const char* data, size_t size, StorageStats& stats) {
+    std::string out;
+    size_t offset = 0;
+    while (offset + kRecordOverheadV1 <= size) {
+        size_t payloadSize = GetU32(data + offset);
+        size_t oldSize = payloadSize + kRecordOverheadV1;
+        if (oldSize > size - offset || GetU32(data + offset + oldSize - 4) != oldSize) {
+            break;
+        }
+
+        size_t start = out.size();
+        out.append(data + offset, kRecordHeaderSize + payloadSize);
+        PutU32(out, Hash::Crc32c(out.data() + start, out.size() - start));
+        PutU32(out, static_cast<uint32_t>(payloadSize + kRecordOverhead));
+        CountRecord(stats, out.data() + start);
+        offset += oldSize;
+    }
+    return out;
+}
+
+// Get the blob hash of a record that references one
+bool GetBlobRef(const char* record, uint64_t& hash) {
+    if (!(static_cast<uint8_t>(record[5]) & kRecordBlobRef) || GetU32(record) != kBlobRefSize) {
+        return false;
+    }
+    hash = GetU64(record + kRecordHeaderSize);
+    return true;
+}
+
+// A blob-backed record's text, read (and decompressed) from the store only
+// when the entry's text is first used
+class BlobText : public StoredText {
+public:
+    BlobText(std::shared_ptr<BlobStore> blobs, uint64_t hash, uint32_t size)
+        : m_blobs(std::move(blobs)), m_hash(hash), m_size(size) {}
+
+    size_t Size() const override { return m_size; }
+    uint64_t Hash() const override { return m_hash; }
+    bool Read(std::string& text) const override { return m_blobs->Read(m_hash, text); }
+
+private:
+    std::shared_ptr<BlobStore> m_blobs;
+    uint64_t m_hash;
+    uint32_t m_size;
+};
+
+// Decode the record starting at data. Referenced payloads are left in blobs,
+// for the entry to load on first use. Returns the record's total size, or 0
+// if the bytes available do not hold a complete, consistent record.
+size_t DecodeRecord(const char* data, size_t available, ClipboardEntry& entry,
+                    const std::shared_ptr<BlobStore>& blobs) {
+    if (available < kRecordOverhead) {
+        return 0;
+    }
+
+    uint32_t payloadSize = GetU32(data);
+    size_t recordSize = static_cast<size_t>(payloadSize) + kRecordOverhead;
+    if (recordSize > available || !CheckRecord(data, recordSize)) {
+        return 0;
+    }
+
+    entry.type = ToDataType(static_cast<unsigned char>(data[4]));
+    entry.timestamp = FromEpochMillis(static_cast<int64_t>(GetU64(data + 8)));
+
+    uint64_t hash;
+    entry.text.clear();
+    entry.stored.reset();
+    if (GetBlobRef(data, hash)) {
+        // A blob lost with an unsynced store leaves the entry empty once loaded
+        if (blobs) {
+            entry.stored = std::make_shared<BlobText>(blobs, hash, GetU32(data + kRecordHeaderSize + 8));
+        }
+    } else {
+        entry.text.assign(data + kRecordHeaderSize, payloadSize);
+    }
+    return recordSize;
+}
+
+// Read a whole file in one go (empty if it cannot be read)
+std::string ReadWholeFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    std::string contents;
+    if (!file) {
+        return contents;
+    }
+    contents.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    file.read(&contents[0], static_cast<std::streamsize>(contents.size()));
+    contents.resize(static_cast<size_t>(file.gcount()));
+    return contents;
+}
+
+// Read up to the first kFileHeaderSize bytes of the file
+std::string ReadFileHeader(const std::filesystem::path& path) {
+    std::string header(kFileHeaderSize, '\0');
+    std::ifstream file(path, std::ios::binary);
+    file.read(&header[0], static_cast<std::streamsize>(header.size()));
+    header.resize(static_cast<size_t>(file.gcount()));
+    return header;
+}
+
+bool HasBinaryHeader(const std::string& contents) {
+    return contents.size() >= kFileHeaderSize &&
+           std::equal(kFileMagic, kFileMagic + sizeof(kFileMagic), contents.begin());
+}
+
+// Hop from record header to record header starting at offset, without
+// reading payloads or checking CRCs. Calls visit(offset, header) for each complete record and
+// returns the offset just past the last one.
+uint64_t ScanRecords(std::ifstream& file, uint64_t offset,
+                     const std::function<void(uint64_t, const char*)>& visit = nullptr) {
+    char header[kRecordHeaderSize];
+    char trailer[kRecordTrailerSize];
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    while (file.read(header, sizeof(header))) {
+        uint64_t recordSize = static_cast<uint64_t>(GetU32(header)) + kRecordOverhead;
+        file.seekg(static_cast<std::streamoff>(offset + recordSize - kRecordTrailerSize), std::ios::beg);
+        if (!file.read(trailer, sizeof(trailer)) || GetU32(trailer + 4) != recordSize) {
+            break;
+        }
+        if (visit) {
+            visit(offset, header);
+        }
+        offset += recordSize;
+    }
+
+    file.clear();
+    return offset;
+}
+
+// Replace the file at path with contents via a temporary file and a rename
+bool ReplaceFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::path tempPath(path.wstring() + L".migrating");
+    std::ofstream temp(tempPath, std::ios::binary | std::ios::trunc);
+    temp.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    temp.close();
+    if (!temp) {
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// Parse one line of the legacy "timestamp|type|text" format
+bool ParseLegacyLine(const std::wstring& line, ClipboardEntry& entry) {
+    size_t firstPipe = line.find(L'|');
+    if (firstPipe == std::wstring::npos) {
+        return false;
+    }
+
+    size_t secondPipe = line.find(L'|', firstPipe + 1);
+    size_t textStart = firstPipe + 1;
+    entry.type = ClipboardDataType::Text; // Default to text for old entries
+
+    if (secondPipe != std::wstring::npos) {
+        try {
+            entry.type = ToDataType(std::stoi(line.substr(firstPipe + 1, secondPipe - firstPipe - 1)));
+        } catch (...) {
+            entry.type = ClipboardDataType::Text;
+        }
+        textStart = secondPipe + 1;
+    }
+
+    try {
+        std::time_t epoch = std::stoll(line.substr(0, firstPipe));
+        entry.timestamp = std::chrono::system_clock::from_time_t(epoch);
+    } catch (...) {
+        entry.timestamp = std::chrono::system_clock::now();
+    }
+
+    // Unescape \n and \p in a single pass
+    std::wstring text;
+    text.reserve(line.size() - textStart);
+    for (size_t i = textStart; i < line.size(); i++) {
+        if (line[i] == L'\\' && i + 1 < line.size() && (line[i + 1] == L'n' || line[i + 1] == L'p')) {
+            text.push_back(line[i + 1] == L'n' ? L'\n' : L'|');
+            i++;
+        } else {
+            text.push_back(line[i]);
+        }
+    }
+    entry.text = TextEncoding::WideToUtf8(text);
+
+    return true;
+}
+
+} // namespace
+
+
+
+FileEngine::FileEngine(const std::wstring& path)
+    : m_path(path)
+    , m_logId(0)
+    , m_blobs(std::make_shared<BlobStore>())
+{
+}
+
+FileEngine::~FileEngine() {
+    Close();
+}
+
+bool FileEngine::Open() {
+    std::filesystem::path path(m_path);
+
+    // Leftovers from an interrupted compaction; the log itself is intact
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::path(m_path + L".compact"), ec);
+    std::filesystem::remove(std::filesystem::path(m_path + L".idx.compact"), ec);
+    std::filesystem::remove(std::filesystem::path(m_path + L".blobs.compact"), ec);
+
+    if (std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > 0) {
+        std::string header = ReadFileHeader(path);
+        if (!HasBinaryHeader(header)) {
+            if (!MigrateLegacyFile()) {
+                std::wcerr << L"Failed to convert legacy storage at: " << m_path << std::endl;
+                return false;
+            }
+        } else if (GetU32(header.data() + 4) > kFormatVersion) {
+            std::wcerr << L"Storage at " << m_path << L" was written by a newer version" << std::endl;
+            return false;
+        } else if (GetU32(header.data() + 4) < kFormatVersion && !UpgradeLog()) {
+            std::wcerr << L"Failed to upgrade storage at: " << m_path << std::endl;
+            return false;
+        }
+    }
+
+    if (m_file.Open(m_path) && m_file.Size() >= kFileHeaderSize) {
+        m_logId = GetU64(ReadFileHeader(path).data() + 16);
+    }
+
+    if (!m_file.IsOpen() || (m_file.Size() == 0 && !CreateLog()) || !RecoverLog() || !LoadIndex() || !LoadStats() ||
+        !m_blobs->Open(m_path + L".blobs")) {
+        m_file.Close();
+        m_indexFile.Close();
+        m_blobs->Close();
+        return false;
+    }
+
+    return true;
+}
+
+void FileEngine::Close() {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    m_file.Close();
+    m_indexFile.Close();
+    m_blobs->Close();
+
+    std::lock_guard<std::mutex> indexLock(m_indexMutex);
+    m_map.Unmap();
+}
+
+bool FileEngine::Append(const std::vector<ClipboardEntry>& batch, bool sync) {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+
+    // Encode the whole batch up front so it reaches the file in one write
+    uint64_t base = m_file.Size();
+    std::string buffer;
+    std::string indexBuffer;
+    std::vector<IndexEntry> added;
+    added.reserve(batch.size());
+    for (const auto& entry : batch) {
+        IndexEntry indexEntry = { base + buffer.size(), ToEpochMillis(entry.timestamp) };
+        PutU64(indexBuffer, indexEntry.offset);
+        PutU64(indexBuffer, static_cast<uint64_t>(indexEntry.timestampMs));
+        added.push_back(indexEntry);
+        EncodeRecord(entry, buffer, m_blobs.get());
+    }
+
+    // New blobs go out before the records that reference them
+    if (!m_blobs->Commit() || !m_file.Append(buffer.data(), buffer.size())) {
+        std::wcerr << L"Failed to write " << batch.size() << L" entries to storage" << std::endl;
+        return false;
+    }
+
+    std::string header;
+    {
+        std::lock_guard<std::mutex> indexLock(m_indexMutex);
+        m_index.insert(m_index.end(), added.begin(), added.end());
+        for (const auto& indexEntry : added) {
+            CountRecord(m_stats, buffer.data() + (indexEntry.offset - base));
+        }
+        header = EncodeFileHeader(m_logId, m_stats, m_file.Size());
+    }
+
+    // Counters follow the data, so a crash in between only leaves records
+    // past the committed size to recount
+    m_file.WriteAt(0, header.data(), header.size());
+
+    // A lagging sidecar is caught up from the log on the next Initialize
+    m_indexFile.Append(indexBuffer.data(), indexBuffer.size());
+
+    return !sync || (m_blobs->Sync() && m_file.Sync());
+}
+
+bool FileEngine::Sync() {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    return m_blobs->Sync() && m_file.Sync();
+}
+
+std::vector<ClipboardEntry> FileEngine::LoadLatest(size_t limit) {
+    std::vector<ClipboardEntry> entries;
+
+    std::ifstream file(std::filesystem::path(m_path), std::ios::binary);
+    if (!file) {
+        return entries;
+    }
+
+    file.seekg(0, std::ios::end);
+    uint64_t end = static_cast<uint64_t>(file.tellg());
+
+    // Walk backwards from the end of the log using each record's trailing size,
+    // so only the newest `limit` records are ever read (newest first)
+    std::string record;
+    bool rescanned = false;
+    while (end > kFileHeaderSize && entries.size() < limit) {
+        char trailer[kRecordTrailerSize];
+        file.seekg(static_cast<std::streamoff>(end - kRecordTrailerSize), std::ios::beg);
+        file.read(trailer, sizeof(trailer));
+
+        uint32_t recordSize = GetU32(trailer + 4);
+        bool framed = file && recordSize >= kRecordOverhead && recordSize <= end - kFileHeaderSize;
+
+        ClipboardEntry entry;
+        if (framed) {
+            record.resize(recordSize);
+            file.seekg(static_cast<std::streamoff>(end - recordSize), std::ios::beg);
+            file.read(&record[0], recordSize);
+            framed = file && DecodeRecord(record.data(), record.size(), entry, m_blobs) == recordSize;
+        }
+
+        if (!framed) {
+            // A torn write at the tail breaks the backward chain. Find the end
+            // of the last complete record with a forward scan and retry once.
+            if (rescanned || entries.size() > 0) {
+                break;
+            }
+            file.clear();
+            uint64_t validEnd = ScanRecords(file, kFileHeaderSize);
+            if (validEnd >= end) {
+                break;
+            }
+            end = validEnd;
+            rescanned = true;
+            continue;
+        }
+
+        entries.push_back(std::move(entry));
+        end -= recordSize;
+    }
+
+    return entries;
+}
+
+void FileEngine::ForEach(const std::function<bool(const ClipboardEntry&)>& visit) {
+    std::ifstream file(std::filesystem::path(m_path), std::ios::binary);
+    if (!file) {
+        return;
+    }
+
+    // Forward through the log, one record at a time
+    std::string record(kRecordHeaderSize, '\0');
+    file.seekg(static_cast<std::streamoff>(kFileHeaderSize), std::ios::beg);
+    while (file.read(&record[0], kRecordHeaderSize)) {
+        size_t recordSize = static_cast<size_t>(GetU32(record.data())) + kRecordOverhead;
+        record.resize(recordSize);
+        if (!file.read(&record[kRecordHeaderSize], static_cast<std::streamsize>(recordSize - kRecordHeaderSize))) {
+            break;
+        }
+
+        ClipboardEntry entry;
+        if (DecodeRecord(record.data(), record.size(), entry, m_blobs) != recordSize || !visit(entry)) {
+            break;
+        }
+        record.resize(kRecordHeaderSize);
+    }
+}
+
+bool FileEngine::Clear() {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    std::lock_guard<std::mutex> indexLock(m_indexMutex);
+
+    // The mapped view has to go before the file can shrink
+    m_map.Unmap();
+    m_index.clear();
+    if (!CreateLog() || !m_blobs->Reset()) {
+        return false;
+    }
+
+    std::string indexHeader = EncodeIndexHeader(m_logId);
+    m_indexFile.Truncate(0);
+    m_indexFile.Append(indexHeader.data(), indexHeader.size());
+    return true;
+}
+
+StorageStats FileEngine::GetStats() {
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    return m_stats;
+}
+
+uint64_t FileEngine::DiskSize() {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    return m_file.Size() + m_blobs->Size();
+}
+
+bool FileEngine::CreateLog() {
+    // Reset the log to just the file header
+    m_logId = NewLogId();
+    m_stats = StorageStats();
+    std::string header = EncodeFileHeader(m_logId, m_stats, kFileHeaderSize);
+    return m_file.Truncate(0) && m_file.Append(header.data(), header.size());
+}
+
+bool FileEngine::Compact(size_t retainEntries, double minSizeRatio) {
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+
+    // Snapshot the retained tail of the index; appends are blocked by
+    // m_fileMutex
+    std::vector<IndexEntry> retained;
+    {
+        std::lock_guard<std::mutex> indexLock(m_indexMutex);
+        if (m_index.size() <= retainEntries) {
+            return false;
+        }
+        retained.assign(m_index.end() - retainEntries, m_index.end());
+    }
+
+    // Deduplicated payloads live in the blob store, so its bytes count
+    // towards making a rewrite worthwhile
+    uint64_t fileSize = m_file.Size();
+    uint64_t retainedBytes = retained.empty() ? 0 : fileSize - retained.front().offset;
+    if (minSizeRatio > 0.0 &&
+        (fileSize + m_blobs->Size() < kMinCompactionBytes || fileSize < minSizeRatio * (kFileHeaderSize + retainedBytes))) {
+        return false;
+    }
+
+    // Use a private view so readers remapping m_map cannot pull it away
+    MappedFile source;
+    if (!source.Map(m_path)) {
+        return false;
+    }
+
+    std::wstring tempPath = m_path + L".compact";
+    std::wstring indexPath = m_path + L".idx";
+    std::wstring indexTempPath = indexPath + L".compact";
+    uint64_t newLogId = NewLogId();
+
+    // Copy the retained records into a fresh log and index, syncing both
+    // before anything is renamed so a crash leaves the old log in place
+    LogFile temp;
+    LogFile indexTemp;
+    bool ok = temp.Open(tempPath) && temp.Truncate(0) && indexTemp.Open(indexTempPath) && indexTemp.Truncate(0);
+
+    // Counters for the new header, and the blob references that survive,
+    // come from the retained records alone
+    StorageStats newStats;
+    uint64_t newSize = kFileHeaderSize;
+    std::vector<uint64_t> referenced;
+    for (size_t i = 0; ok && i < retained.size(); i++) {
+        uint64_t offset = retained[i].offset;
+        ok = offset + kRecordOverhead <= source.Size() &&
+             offset + GetU32(source.Data() + offset) + kRecordOverhead <= source.Size();
+        uint64_t hash;
+        if (ok) {
+            CountRecord(newStats, source.Data() + offset);
+            newSize += GetU32(source.Data() + offset) + kRecordOverhead;
+            if (GetBlobRef(source.Data() + offset, hash)) {
+                referenced.push_back(hash);
+            }
+        }
+    }
+
+    std::string buffer = EncodeFileHeader(newLogId, newStats, newSize);
+    std::string indexBuffer = EncodeIndexHeader(newLogId);
+    std::vector<IndexEntry> newIndex;
+    newIndex.reserve(retained.size());
+    for (size_t i = 0; ok && i < retained.size(); i++) {
+        uint64_t offset = retained[i].offset;
+        uint64_t recordSize = GetU32(source.Data() + offset) + kRecordOverhead;
+
+        IndexEntry moved = { temp.Size() + buffer.size(), retained[i].timestampMs };
+        newIndex.push_back(moved);
+        PutU64(indexBuffer, moved.offset);
+        PutU64(indexBuffer, static_cast<uint64_t>(moved.timestampMs));
+        buffer.append(source.Data() + offset, static_cast<size_t>(recordSize));
+
+        if (buffer.size() >= (1 << 22)) {
+            ok = temp.Append(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    ok = ok && temp.Append(buffer.data(), buffer.size()) && temp.Sync();
+    ok = ok && indexTemp.Append(indexBuffer.data(), indexBuffer.size()) && indexTemp.Sync();
+    temp.Close();
+    indexTemp.Close();
+    source.Unmap();
+
+    std::error_code ec;
+    if (!ok) {
+        std::filesystem::remove(std::filesystem::path(tempPath), ec);
+        std::filesystem::remove(std::filesystem::path(indexTempPath), ec);
+        std::wcerr << L"Storage compaction failed; keeping the existing log" << std::endl;
+        return false;
+    }
+
+    // Swap the new files in. Handles are closed first because Windows
+    // cannot replace a file that is open or mapped.
+    std::lock_guard<std::mutex> indexLock(m_indexMutex);
+    size_t oldCount = m_index.size();
+    m_map.Unmap();
+    m_file.Close();
+    m_indexFile.Close();
+
+    std::filesystem::rename(std::filesystem::path(tempPath), std::filesystem::path(m_path), ec);
+    bool swapped = !ec;
+    if (swapped) {
+        m_logId = newLogId;
+        m_index.swap(newIndex);
+        m_stats = newStats;
+
+        // If this rename is lost the stale sidecar no longer matches the
+        // log id and is rebuilt on the next Initialize
+        std::filesystem::rename(std::filesystem::path(indexTempPath), std::filesystem::path(indexPath), ec);
+    }
+    std::filesystem::remove(std::filesystem::path(tempPath), ec);
+    std::filesystem::remove(std::filesystem::path(indexTempPath), ec);
+
+    if (!m_file.Open(m_path) || !m_indexFile.Open(indexPath)) {
+        std::wcerr << L"Failed to reopen storage after compaction" << std::endl;
+        return false;
+    }
+
+    if (swapped) {
+        // Only now that the old log is gone can its blobs go too
+        m_blobs->ClearRefs();
+        for (uint64_t hash : referenced) {
+            m_blobs->AddRef(hash);
+        }
+        m_blobs->Compact();
+        std::wcout << L"Compacted storage: kept " << m_index.size() << L" of " << oldCount << L" entries" << std::endl;
+    }
+    return swapped;
+}
+
+bool FileEngine::ReadAt(size_t position, ClipboardEntry& entry) {
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    return position < m_index.size() && ReadIndexed(m_index.size() - 1 - position, entry);
+}
+
+bool FileEngine::ReadIndexed(size_t slot, ClipboardEntry& entry) {
+    // Caller holds m_indexMutex
+    uint64_t offset = m_index[slot].offset;
+    if (!EnsureMapped(offset + kRecordHeaderSize)) {
+        return false;
+    }
+
+    uint64_t recordSize = static_cast<uint64_t>(GetU32(m_map.Data() + offset)) + kRecordOverhead;
+    if (!EnsureMapped(offset + recordSize)) {
+        return false;
+    }
+
+    return DecodeRecord(m_map.Data() + offset, static_cast<size_t>(m_map.Size() - offset), entry, m_blobs) == recordSize;
+}
+
+bool FileEngine::FindByTime(std::chrono::system_clock::time_point time, size_t& position) {
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+
+    // Records are appended in capture order, so timestamps are non-decreasing
+    // (barring wall-clock adjustments) and can be binary searched
+    int64_t target = ToEpochMillis(time);
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), target,
+        [](int64_t value, const IndexEntry& indexEntry) { return value < indexEntry.timestampMs; });
+    if (it == m_index.begin()) {
+        return false;
+    }
+
+    position = static_cast<size_t>(m_index.end() - it);
+    return true;
+}
+
+bool FileEngine::EnsureMapped(uint64_t end) {
+    // Caller holds m_indexMutex. Remap when the log has grown past the view.
+    if (m_map.IsMapped() && m_map.Size() >= end) {
+        return true;
+    }
+    return m_map.Map(m_path) && m_map.Size() >= end;
+}
+
+bool FileEngine::LoadIndex() {
+    std::wstring indexPath = m_path + L".idx";
+    std::vector<IndexEntry> index;
+    bool valid = false;
+
+    // Read whatever the sidecar holds, ignoring a torn final entry
+    {
+        std::string contents = ReadWholeFile(std::filesystem::path(indexPath));
+        if (contents.size() >= kIndexHeaderSize &&
+            std::equal(kIndexMagic, kIndexMagic + sizeof(kIndexMagic), contents.begin()) &&
+            GetU32(contents.data() + 4) == kIndexVersion && GetU64(contents.data() + 8) == m_logId) {
+            valid = true;
+            size_t count = (contents.size() - kIndexHeaderSize) / kIndexEntrySize;
+            index.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                const char* p = contents.data() + kIndexHeaderSize + i * kIndexEntrySize;
+                index.push_back({ GetU64(p), static_cast<int64_t>(GetU64(p + 8)) });
+            }
+        }
+    }
+
+    std::ifstream log(std::filesystem::path(m_path), std::ios::binary);
+    if (!log) {
+        return false;
+    }
+
+    // Trust the sidecar only if its offsets increase and its last entry still
+    // points at a complete record; otherwise rebuild it from scratch
+    for (size_t i = 0; i < index.size() && valid; i++) {
+        valid = index[i].offset >= kFileHeaderSize && (i == 0 || index[i].offset > index[i - 1].offset);
+    }
+    if (!valid) {
+        index.clear();
+    }
+
+    auto append = [&index](uint64_t offset, const char* header) {
+        index.push_back({ offset, static_cast<int64_t>(GetU64(header + 8)) });
+    };
+
+    // Catch up with records the sidecar does not cover yet, starting from
+    // (and re-checking) the last record it does cover
+    size_t indexedCount = index.size();
+    if (!index.empty()) {
+        bool lastFound = false;
+        ScanRecords(log, index.back().offset, [&](uint64_t offset, const char* header) {
+            if (lastFound) {
+                append(offset, header);
+            }
+            lastFound = true;
+        });
+        if (!lastFound) {
+            valid = false;
+            index.clear();
+            indexedCount = 0;
+        }
+    }
+    if (index.empty()) {
+        ScanRecords(log, kFileHeaderSize, append);
+    }
+
+    if (!m_indexFile.Open(indexPath)) {
+        return false;
+    }
+
+    std::string buffer;
+    if (!valid) {
+        buffer = EncodeIndexHeader(m_logId);
+        m_indexFile.Truncate(0);
+    } else {
+        m_indexFile.Truncate(kIndexHeaderSize + indexedCount * kIndexEntrySize);
+    }
+    for (size_t i = valid ? indexedCount : 0; i < index.size(); i++) {
+        PutU64(buffer, index[i].offset);
+        PutU64(buffer, static_cast<uint64_t>(index[i].timestampMs));
+    }
+    m_indexFile.Append(buffer.data(), buffer.size());
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    m_index.swap(index);
+    return true;
+}
+
+bool FileEngine::LoadStats() {
+    std::filesystem::path path(m_path);
+    StorageStats stats;
+    uint64_t committed = DecodeFileCounters(ReadFileHeader(path), stats);
+    uint64_t size = m_file.Size();
+
+    if (committed != size) {
+        // Recovery: count whatever lies past the committed size, or everything
+        // if the header cannot be trusted at all
+        if (committed < kFileHeaderSize || committed > size) {
+            stats = StorageStats();
+            committed = kFileHeaderSize;
+        }
+
+        std::ifstream log(path, std::ios::binary);
+        if (!log) {
+            return false;
+        }
+        ScanRecords(log, committed, [&stats](uint64_t, const char* header) { CountRecord(stats, header); });
+
+        std::string header = EncodeFileHeader(m_logId, stats, size);
+        m_file.WriteAt(0, header.data(), header.size());
+        std::wcout << L"Recovered storage counters (" << stats.entryCount << L" entries)" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    m_stats = stats;
+    return true;
+}
+
+bool FileEngine::MigrateLegacyFile() {
+    std::filesystem::path path(m_path);
+
+    std::ifstream legacy(path, std::ios::binary);
+    if (!legacy) {
+        return false;
+    }
+
+    std::string records;
+    StorageStats stats;
+
+    // The old wofstream wrote in the "C" locale, one byte per character, so
+    // each byte is read back as the character with that value (Latin-1).
+    // A wifstream would stop at the first byte outside ASCII on some
+    // platforms and drop the rest of the file.
+    std::string bytes;
+    while (std::getline(legacy, bytes)) {
+        if (!bytes.empty() && bytes.back() == '\r') {
+            bytes.pop_back();
+        }
+        std::wstring line(bytes.size(), L'\0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            line[i] = static_cast<wchar_t>(static_cast<unsigned char>(bytes[i]));
+        }
+
+        ClipboardEntry entry;
+        if (!ParseLegacyLine(line, entry)) {
+            continue;
+        }
+        size_t offset = records.size();
+        EncodeRecord(entry, records);
+        CountRecord(stats, records.data() + offset);
+    }
+    legacy.close();
+
+    std::string buffer = EncodeFileHeader(NewLogId(), stats, kFileHeaderSize + records.size());
+    buffer.append(records);
+    if (!ReplaceFile(path, buffer)) {
+        return false;
+    }
+
+    std::wcout << L"Converted " << stats.entryCount << L" legacy entries to binary storage" << std::endl;
+    return true;
+}
+
+bool FileEngine::UpgradeLog() {
+    std::filesystem::path path(m_path);
+
+    std::string contents = ReadWholeFile(path);
+    if (!HasBinaryHeader(contents)) {
+        return false;
+    }
+
+    StorageStats stats;
+    std::string records = UpgradeRecords(contents.data() + kFileHeaderSize, contents.size() - kFileHeaderSize, stats);
+
+    // A new log id retires the old sidecar index, whose offsets no longer hold
+    std::string buffer = EncodeFileHeader(NewLogId(), stats, kFileHeaderSize + records.size());
+    buffer.append(records);
+    if (!ReplaceFile(path, buffer)) {
+        return false;
+    }
+
+    std::wcout << L"Upgraded " << stats.entryCount << L" entries to storage format " << kFormatVersion << std::endl;
+    return true;
+}
+
+bool FileEngine::RecoverLog() {
+    MappedFile view;
+    if (!view.Map(m_path)) {
+        return false;
+    }
+
+    // Check the records past the committed size, stopping at the first one
+    // that fails. If the record before them does not check out either, the
+    // header got ahead of the data it covers; check everything.
+    const char* data = view.Data();
+    uint64_t size = view.Size();
+    StorageStats stats;
+    std::string header(data, static_cast<size_t>(std::min<uint64_t>(size, kFileHeaderSize)));
+    uint64_t offset = DecodeFileCounters(header, stats);
+    if (offset < kFileHeaderSize || offset > size || !EndsRecord(data, offset)) {
+        offset = kFileHeaderSize;
+    }
+    while (size >= kRecordOverhead && offset <= size - kRecordOverhead) {
+        uint64_t recordSize = static_cast<uint64_t>(GetU32(data + offset)) + kRecordOverhead;
+        if (recordSize > size - offset || !CheckRecord(data + offset, static_cast<size_t>(recordSize))) {
+            break;
+        }
+        offset += recordSize;
+    }
+    if (offset >= size) {
+        return true;
+    }
+
+    // For the report, count how many records still look framed past the cut
+    uint64_t dropped = 0;
+    for (uint64_t next = offset; size >= kRecordOverhead && next <= size - kRecordOverhead; dropped++) {
+        uint64_t recordSize = static_cast<uint64_t>(GetU32(data + next)) + kRecordOverhead;
+        if (recordSize > size - next || GetU32(data + next + recordSize - 4) != recordSize) {
+            break;
+        }
+        next += recordSize;
+    }
+    view.Unmap();
+
+    std::wcerr << L"Storage recovery: dropped " << (size - offset) << L" bytes (" << dropped
+               << L" records) after the last valid record at offset " << offset << std::endl;
+
+    // Counters past the new end are recounted by LoadStats
+    return m_file.Truncate(offset);
+}
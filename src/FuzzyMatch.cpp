@@ -0,0 +1,124 @@
+#include "FuzzyMatch.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// fzf's weights
+const int kScoreMatch = 16;
+const int kScoreGapStart = -3;
+const int kScoreGapExtension = -1;
+const int kBonusBoundary = kScoreMatch / 2;
+const int kBonusNonWord = kScoreMatch / 2;
+const int kBonusCamel123 = kBonusBoundary + kScoreGapExtension;
+const int kBonusConsecutive = -(kScoreGapStart + kScoreGapExtension);
+const int kBonusFirstCharMultiplier = 2;
+
+enum class CharClass {
+    NonWord,
+    Lower,
+    Upper,
+    Number
+};
+
+CharClass ClassOf(unsigned char folded, unsigned char original) {
+    if (original >= 'A' && original <= 'Z') {
+        return CharClass::Upper;
+    }
+    if (folded >= 'a' && folded <= 'z') {
+        return CharClass::Lower;
+    }
+    if (folded >= '0' && folded <= '9') {
+        return CharClass::Number;
+    }
+    // Bytes of non-ASCII characters count as letters
+    return folded >= 0x80 ? CharClass::Lower : CharClass::NonWord;
+}
+
+int BonusFor(CharClass previous, CharClass current) {
+    if (previous == CharClass::NonWord && current != CharClass::NonWord) {
+        return kBonusBoundary;
+    }
+    if ((previous == CharClass::Lower && current == CharClass::Upper) ||
+        (previous != CharClass::Number && current == CharClass::Number)) {
+        return kBonusCamel123;
+    }
+    if (current == CharClass::NonWord) {
+        return kBonusNonWord;
+    }
+    return 0;
+}
+
+} // namespace
+
+bool FuzzyMatch::Score(std::string_view text, std::string_view folded, std::string_view pattern, int& score) {
+    score = 0;
+    if (pattern.empty()) {
+        return true;
+    }
+
+    // Earliest match: each pattern byte after the previous one
+    const char* data = folded.data();
+    size_t position = 0;
+    size_t start = 0;
+    for (size_t p = 0; p < pattern.size(); p++) {
+        const void* found = std::memchr(data + position, pattern[p], folded.size() - position);
+        if (!found) {
+            return false;
+        }
+        position = static_cast<const char*>(found) - data;
+        if (p == 0) {
+            start = position;
+        }
+        position++;
+    }
+    size_t end = position;
+
+    // Walk back from its end to the latest start that still matches
+    size_t p = pattern.size();
+    for (size_t i = end; i-- > start;) {
+        if (data[i] == pattern[p - 1] && --p == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    bool aligned = text.size() == folded.size();
+    auto classAt = [&](size_t i) {
+        unsigned char byte = static_cast<unsigned char>(data[i]);
+        return ClassOf(byte, aligned ? static_cast<unsigned char>(text[i]) : byte);
+    };
+
+    CharClass previous = start > 0 ? classAt(start - 1) : CharClass::NonWord;
+    bool inGap = false;
+    int consecutive = 0;
+    int firstBonus = 0;
+    p = 0;
+    for (size_t i = start; i < end; i++) {
+        CharClass current = classAt(i);
+        if (p < pattern.size() && data[i] == pattern[p]) {
+            score += kScoreMatch;
+            int bonus = BonusFor(previous, current);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            } else {
+                // A run keeps the bonus of the boundary it started at
+                if (bonus >= kBonusBoundary && bonus > firstBonus) {
+                    firstBonus = bonus;
+                }
+                bonus = std::max(std::max(bonus, firstBonus), kBonusConsecutive);
+            }
+            score += p == 0 ? bonus * kBonusFirstCharMultiplier : bonus;
+            inGap = false;
+            consecutive++;
+            p++;
+        } else {
+            score += inGap ? kScoreGapExtension : kScoreGapStart;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        previous = current;
+    }
+    return true;
+}
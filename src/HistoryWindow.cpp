@@ -1,4 +1,5 @@
 #include "HistoryWindow.h"
+#include "TextEncoding.h"
 #include <windowsx.h>
 #include <sstream>
 #include <algorithm>
@@ -8,6 +9,9 @@
 #define ID_QUIT_BUTTON 1003
 #define ID_DIVIDER 1004
 
+// Rows the list shows, each with a Ctrl+digit shortcut
+const int kMaxListedItems = 10;
+
 HistoryWindow::HistoryWindow()
     : m_hwnd(nullptr)
     , m_searchEdit(nullptr)
@@ -19,6 +23,9 @@ HistoryWindow::HistoryWindow()
     , m_bgBrush(nullptr)
     , m_isVisible(false)
     , m_restoreCallback(nullptr)
+    , m_coldSearch(nullptr)
+    , m_coldTicket(0)
+    , m_fuzzy(false)
     , m_oldEditProc(nullptr)
     , m_oldListViewProc(nullptr)
     , m_selectedIndex(0)
@@ -426,7 +433,7 @@ void HistoryWindow::OnSize(int width, int height) {
     }
 }
 
-void HistoryWindow::UpdateHistory(const std::vector<ClipboardEntry>& entries) {
+void HistoryWindow::UpdateHistory(const HistorySnapshot& entries) {
     m_allEntries = entries;
 
     // Get current search text
@@ -437,7 +444,7 @@ void HistoryWindow::UpdateHistory(const std::vector<ClipboardEntry>& entries) {
     FilterAndDisplay(m_currentFilter);
 }
 
-void HistoryWindow::RefreshIfVisible(const std::vector<ClipboardEntry>& entries) {
+void HistoryWindow::RefreshIfVisible(const HistorySnapshot& entries) {
     if (m_isVisible) {
         UpdateHistory(entries);
     } else {
@@ -458,59 +465,59 @@ void HistoryWindow::OnSearchTextChanged() {
 void HistoryWindow::FilterAndDisplay(const std::wstring& filter) {
     ListView_DeleteAllItems(m_listView);
 
-    std::wstring lowerFilter = filter;
-    std::transform(lowerFilter.begin(), lowerFilter.end(), lowerFilter.begin(), towlower);
+    // Entries are matched as UTF-8, the same way ClipboardHistory::Search does
+    std::string utf8Filter = TextEncoding::WideToUtf8(filter);
 
     int displayIndex = 1;
-    const int maxItems = 10; // Limit to 10 items
+    const int maxItems = kMaxListedItems;
 
-    for (size_t i = 0; i < m_allEntries.size() && displayIndex <= maxItems; i++) {
-        const auto& entry = m_allEntries[i];
+    // Fuzzy mode ranks only the best rows; otherwise matches stay in
+    // recency order
+    std::vector<size_t> ranked;
+    if (m_fuzzy && !utf8Filter.empty()) {
+        ranked = ClipboardHistory::RankFuzzy(m_allEntries, utf8Filter, maxItems);
+    }
+    const std::vector<size_t>& matches = m_fuzzy && !utf8Filter.empty() ? ranked : m_search.Update(m_allEntries, utf8Filter);
 
-        // Filter by search text
-        if (!lowerFilter.empty()) {
-            std::wstring lowerText = entry.text;
-            std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(), towlower);
+    for (size_t k = 0; k < matches.size() && displayIndex <= maxItems; k++) {
+        const auto& entry = m_allEntries[matches[k]];
+        AddListItem(displayIndex - 1, matches[k], entry.type, entry.text);
+        displayIndex++;
+    }
 
-            if (lowerText.find(lowerFilter) == std::wstring::npos) {
-                continue; // Skip entries that don't match
-            }
+    // Fill the remaining rows with older matches paged in from storage,
+    // once the cold search finishes. Their substring matches cannot be
+    // ranked against fuzzy ones.
+    m_coldMatches.clear();
+    m_coldTicket = 0;
+    if (m_coldSearch) {
+        if (!utf8Filter.empty() && !m_fuzzy && displayIndex <= maxItems) {
+            m_coldTicket = m_coldSearch->Request(utf8Filter, maxItems - displayIndex + 1);
+        } else {
+            m_coldSearch->Cancel();
         }
+    }
 
-        // Add item to list view
-        LVITEM lvi = {0};
-        lvi.mask = LVIF_TEXT | LVIF_PARAM;
-        lvi.iItem = displayIndex - 1;
-        lvi.lParam = i; // Store original index
-
-        // Column 0: Index (1-9, 0 for 10th item)
-        wchar_t indexStr[16];
-        wsprintf(indexStr, L"%d", displayIndex % 10);
-        lvi.pszText = indexStr;
-        ListView_InsertItem(m_listView, &lvi);
-
-        // Column 1: Type
-        const wchar_t* typeStr = L"TEXT";
-        if (entry.type == ClipboardDataType::Files) typeStr = L"FILES";
-        else if (entry.type == ClipboardDataType::Image) typeStr = L"IMAGE";
-        ListView_SetItemText(m_listView, displayIndex - 1, 1, (LPWSTR)typeStr);
-
-        // Column 2: Content
-        std::wstring content = entry.text;
-        if (content.length() > 80) {
-            content = content.substr(0, 80) + L"...";
-        }
-        // Replace newlines with spaces
-        std::replace(content.begin(), content.end(), L'\n', L' ');
-        std::replace(content.begin(), content.end(), L'\r', L' ');
+    FitToItems(displayIndex - 1);
+}
 
-        ListView_SetItemText(m_listView, displayIndex - 1, 2, (LPWSTR)content.c_str());
+void HistoryWindow::OnColdSearchDone() {
+    std::vector<ClipboardEntry> matches;
+    if (!m_coldSearch || !m_coldSearch->TakeResults(m_coldTicket, matches)) {
+        return;
+    }
+    m_coldTicket = 0;
+    m_coldMatches.swap(matches);
 
-        displayIndex++;
+    int row = ListView_GetItemCount(m_listView);
+    for (size_t k = 0; k < m_coldMatches.size() && row < kMaxListedItems; k++, row++) {
+        AddListItem(row, m_allEntries.Size() + k, m_coldMatches[k].type, m_coldMatches[k].text);
     }
+    FitToItems(row);
+}
 
+void HistoryWindow::FitToItems(int itemCount) {
     // Resize ListView based on number of items
-    int itemCount = displayIndex - 1;
     int itemHeight = 20; // Approximate height per item
     int minHeight = itemHeight * 2; // Minimum height for 2 items
     int listHeight = itemCount * itemHeight;
@@ -555,9 +562,10 @@ void HistoryWindow::OnListDoubleClick() {
         ListView_GetItem(m_listView, &lvi);
 
         int originalIndex = (int)lvi.lParam;
-        if (originalIndex >= 0 && originalIndex < (int)m_allEntries.size()) {
+        ClipboardEntry entry;
+        if (GetListedEntry(originalIndex, entry)) {
             if (m_restoreCallback) {
-                m_restoreCallback(m_allEntries[originalIndex]);
+                m_restoreCallback(entry);
             }
             Hide();
         }
@@ -593,6 +601,16 @@ bool HistoryWindow::OnKeyDown(WPARAM key) {
 
     // Check for Ctrl+1 through Ctrl+0
     if (GetKeyState(VK_CONTROL) & 0x8000) {
+        // Ctrl+F switches between substring and fuzzy search
+        if (key == 'F') {
+            m_fuzzy = !m_fuzzy;
+            SendMessage(m_searchEdit, EM_SETCUEBANNER, TRUE,
+                        (LPARAM)(m_fuzzy ? L"Fuzzy search clipboard history..." : L"Search clipboard history..."));
+            m_selectedIndex = 0;
+            FilterAndDisplay(m_currentFilter);
+            return true;
+        }
+
         int itemIndex = -1;
 
         // Ctrl+1 = item 0, Ctrl+2 = item 1, ..., Ctrl+0 = item 9
@@ -610,9 +628,10 @@ bool HistoryWindow::OnKeyDown(WPARAM key) {
             ListView_GetItem(m_listView, &lvi);
 
             int originalIndex = (int)lvi.lParam;
-            if (originalIndex >= 0 && originalIndex < (int)m_allEntries.size()) {
+            ClipboardEntry entry;
+            if (GetListedEntry(originalIndex, entry)) {
                 if (m_restoreCallback) {
-                    m_restoreCallback(m_allEntries[originalIndex]);
+                    m_restoreCallback(entry);
                 }
                 Hide();
                 return true;
@@ -630,9 +649,10 @@ bool HistoryWindow::OnKeyDown(WPARAM key) {
             ListView_GetItem(m_listView, &lvi);
 
             int originalIndex = (int)lvi.lParam;
-            if (originalIndex >= 0 && originalIndex < (int)m_allEntries.size()) {
+            ClipboardEntry entry;
+            if (GetListedEntry(originalIndex, entry)) {
                 if (m_restoreCallback) {
-                    m_restoreCallback(m_allEntries[originalIndex]);
+                    m_restoreCallback(entry);
                 }
                 Hide();
                 return true;
@@ -643,21 +663,78 @@ bool HistoryWindow::OnKeyDown(WPARAM key) {
     return false; // Key not handled
 }
 
+void HistoryWindow::AddListItem(int row, LPARAM originalIndex, ClipboardDataType type, std::string_view text) {
+    // Add item to list view
+    LVITEM lvi = {0};
+    lvi.mask = LVIF_TEXT | LVIF_PARAM;
+    lvi.iItem = row;
+    lvi.lParam = originalIndex; // Store original index
+
+    // Column 0: Index (1-9, 0 for 10th item)
+    wchar_t indexStr[16];
+    wsprintf(indexStr, L"%d", (row + 1) % 10);
+    lvi.pszText = indexStr;
+    ListView_InsertItem(m_listView, &lvi);
+
+    // Column 1: Type
+    const wchar_t* typeStr = L"TEXT";
+    if (type == ClipboardDataType::Files) typeStr = L"FILES";
+    else if (type == ClipboardDataType::Image) typeStr = L"IMAGE";
+    ListView_SetItemText(m_listView, row, 1, (LPWSTR)typeStr);
+
+    // Column 2: Content
+    // Only the shown prefix is converted to UTF-16. 80 characters never
+    // take more than 320 UTF-8 bytes.
+    size_t prefixBytes = std::min<size_t>(text.size(), 80 * 4);
+    std::wstring content = TextEncoding::Utf8ToWide(text.data(), prefixBytes);
+    if (content.length() > 80 || prefixBytes < text.size()) {
+        content = content.substr(0, 80) + L"...";
+    }
+    // Replace newlines with spaces
+    std::replace(content.begin(), content.end(), L'\n', L' ');
+    std::replace(content.begin(), content.end(), L'\r', L' ');
+
+    ListView_SetItemText(m_listView, row, 2, (LPWSTR)content.c_str());
+}
+
+bool HistoryWindow::GetListedEntry(int originalIndex, ClipboardEntry& entry) const {
+    if (originalIndex < 0) {
+        return false;
+    }
+    size_t index = static_cast<size_t>(originalIndex);
+    if (index < m_allEntries.Size()) {
+        return m_allEntries.GetEntry(index, entry);
+    }
+    index -= m_allEntries.Size();
+    if (index < m_coldMatches.size()) {
+        entry = m_coldMatches[index];
+        return true;
+    }
+    return false;
+}
+
+void HistoryWindow::SetColdSearch(ColdSearch* search) {
+    m_coldSearch = search;
+}
+
 void HistoryWindow::SetRestoreCallback(RestoreCallback callback) {
     m_restoreCallback = callback;
 }
 
-std::wstring HistoryWindow::GetEntryDisplayText(const ClipboardEntry& entry, int index) {
+std::wstring HistoryWindow::GetEntryDisplayText(const HistoryItem& entry, int index) {
     std::wostringstream oss;
     oss << index << L". ";
 
     switch (entry.type) {
         case ClipboardDataType::Text:
-            oss << L"[TEXT] " << entry.text.substr(0, 60);
-            if (entry.text.length() > 60) oss << L"...";
+        {
+            std::wstring text = TextEncoding::Utf8ToWide(entry.text.data(), std::min<size_t>(entry.text.size(), 60 * 4));
+            oss << L"[TEXT] " << text.substr(0, 60);
+            if (text.length() > 60 || entry.text.size() > 60 * 4) oss << L"...";
             break;
+        }
         case ClipboardDataType::Files:
-            oss << L"[FILES] " << entry.text;
+            oss << L"[FILES] " << TextEncoding::Utf8ToWide(entry.text.data(), entry.text.size());
             break;
         case ClipboardDataType::Image:
             oss << L"[IMAGE]";
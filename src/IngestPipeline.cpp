@@ -0,0 +1,98 @@
+#include "IngestPipeline.h"
+#include <iostream>
+
+IngestPipeline::IngestPipeline(ClipboardHistory& history, Storage& storage, size_t capacity)
+    : m_history(history)
+    , m_storage(storage)
+    , m_queue(capacity)
+    , m_stopping(false)
+    , m_sleeping(false)
+    , m_submitted(0)
+    , m_processed(0)
+{
+}
+
+IngestPipeline::~IngestPipeline() {
+    Stop();
+}
+
+void IngestPipeline::SetBatchCallback(BatchCallback callback) {
+    m_batchCallback = callback;
+}
+
+bool IngestPipeline::Start() {
+    if (m_consumer.joinable()) {
+        return true;
+    }
+    m_stopping = false;
+    m_consumer = std::thread(&IngestPipeline::ConsumerLoop, this);
+    return true;
+}
+
+void IngestPipeline::Stop() {
+    if (!m_consumer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wakeCv.notify_one();
+
+    // The consumer drains the queue before it exits
+    m_consumer.join();
+}
+
+bool IngestPipeline::Submit(ClipboardEntry entry) {
+    if (!m_queue.TryPush(std::move(entry))) {
+        std::wcerr << L"Clipboard ingest queue is full; dropped an entry" << std::endl;
+        return false;
+    }
+    m_submitted++;
+
+    // Pairs with the fence in ConsumerLoop: either the consumer sees the
+    // new entry before it parks, or this sees that it is parking
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.notify_one();
+    }
+    return true;
+}
+
+void IngestPipeline::Flush() {
+    uint64_t target = m_submitted;
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_drainedCv.wait(lock, [this, target]() { return m_processed >= target || !m_consumer.joinable(); });
+}
+
+void IngestPipeline::ConsumerLoop() {
+    while (true) {
+        uint64_t count = 0;
+        ClipboardEntry entry;
+        while (m_queue.TryPop(entry)) {
+            m_storage.SaveEntry(entry);
+            m_history.AddEntry(std::move(entry));
+            count++;
+        }
+
+        if (count > 0) {
+            if (m_batchCallback) {
+                m_batchCallback();
+            }
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_processed += count;
+            m_drainedCv.notify_all();
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_wakeCv.wait(lock, [this]() { return !m_queue.Empty() || m_stopping; });
+        m_sleeping.store(false, std::memory_order_relaxed);
+
+        if (m_stopping && m_queue.Empty()) {
+            break;
+        }
+    }
+}
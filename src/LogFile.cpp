@@ -0,0 +1,177 @@
+#include "LogFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include "TextEncoding.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+
+LogFile::LogFile()
+    : m_handle(INVALID_HANDLE_VALUE)
+    , m_size(0)
+{
+}
+
+bool LogFile::Open(const std::wstring& path) {
+    Close();
+
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    m_handle = handle;
+    m_size = static_cast<uint64_t>(size.QuadPart);
+    return true;
+}
+
+void LogFile::Close() {
+    if (m_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_handle);
+        m_handle = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+bool LogFile::IsOpen() const {
+    return m_handle != INVALID_HANDLE_VALUE;
+}
+
+bool LogFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        OVERLAPPED ov = {0};
+        ov.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+        DWORD written = 0;
+        if (!WriteFile(m_handle, p, chunk, &written, &ov) || written == 0) {
+            return false;
+        }
+        p += written;
+        size -= written;
+        offset += written;
+        if (offset > m_size) {
+            m_size = offset;
+        }
+    }
+    return true;
+}
+
+bool LogFile::Truncate(uint64_t size) {
+    LARGE_INTEGER pos;
+    pos.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(m_handle, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(m_handle)) {
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+bool LogFile::Sync() {
+    return FlushFileBuffers(m_handle) != FALSE;
+}
+
+#else
+
+LogFile::LogFile()
+    : m_fd(-1)
+    , m_size(0)
+{
+}
+
+bool LogFile::Open(const std::wstring& path) {
+    Close();
+
+    int fd = ::open(TextEncoding::WideToUtf8(path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    m_fd = fd;
+    m_size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+void LogFile::Close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+}
+
+bool LogFile::IsOpen() const {
+    return m_fd >= 0;
+}
+
+bool LogFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::pwrite(m_fd, p, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+        if (offset > m_size) {
+            m_size = offset;
+        }
+    }
+    return true;
+}
+
+bool LogFile::Truncate(uint64_t size) {
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+bool LogFile::Sync() {
+#ifdef __APPLE__
+    return fsync(m_fd) == 0;
+#else
+    return fdatasync(m_fd) == 0;
+#endif
+}
+
+#endif
+
+LogFile::~LogFile() {
+    Close();
+}
+
+uint64_t LogFile::Size() const {
+    return m_size;
+}
+
+bool LogFile::Append(const void* data, size_t size) {
+    return WriteAt(m_size, data, size);
+}
@@ -0,0 +1,46 @@
+#include "MappedEngine.h"
+#include <algorithm>
+
+MappedEngine::MappedEngine(const std::wstring& path)
+    : FileEngine(path)
+{
+}
+
+std::vector<ClipboardEntry> MappedEngine::LoadLatest(size_t limit) {
+    std::vector<ClipboardEntry> entries;
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+
+    size_t count = std::min(limit, m_index.size());
+    entries.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        ClipboardEntry entry;
+        if (!ReadIndexed(m_index.size() - 1 - i, entry)) {
+            break;
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+void MappedEngine::ForEach(const std::function<bool(const ClipboardEntry&)>& visit) {
+    // Hold the index lock only while decoding, not while visiting, so a
+    // visitor can call back into the engine
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        count = m_index.size();
+    }
+
+    for (size_t slot = 0; slot < count; slot++) {
+        ClipboardEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(m_indexMutex);
+            if (slot >= m_index.size() || !ReadIndexed(slot, entry)) {
+                return;
+            }
+        }
+        if (!visit(entry)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include "TextEncoding.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+{
+}
+
+bool MappedFile::Map(const std::wstring& path) {
+    Unmap();
+
+    // Share write and delete access so the log can keep growing underneath us
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        // Zero-length files cannot be mapped; treat as an empty view
+        CloseHandle(file);
+        return size.QuadPart == 0;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<uint64_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+#else
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+{
+}
+
+bool MappedFile::Map(const std::wstring& path) {
+    Unmap();
+
+    int fd = ::open(TextEncoding::WideToUtf8(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), static_cast<size_t>(m_size));
+        m_data = nullptr;
+    }
+    m_size = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+bool MappedFile::IsMapped() const {
+    return m_data != nullptr;
+}
+
+const char* MappedFile::Data() const {
+    return m_data;
+}
+
+uint64_t MappedFile::Size() const {
+    return m_size;
+}
@@ -0,0 +1,106 @@
+#include "MemoryEngine.h"
+#include <algorithm>
+
+namespace {
+
+// Count an entry the way the on-disk engines do: UTF-8 payload bytes
+void CountEntry(StorageStats& stats, const ClipboardEntry& entry) {
+    stats.entryCount++;
+    stats.payloadBytes += entry.text.size();
+    stats.typeCounts[static_cast<size_t>(entry.type)]++;
+}
+
+} // namespace
+
+MemoryEngine::MemoryEngine() {
+}
+
+bool MemoryEngine::Open() {
+    return true;
+}
+
+void MemoryEngine::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_stats = StorageStats();
+}
+
+bool MemoryEngine::Append(const std::vector<ClipboardEntry>& batch, bool) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : batch) {
+        CountEntry(m_stats, entry);
+    }
+    m_entries.insert(m_entries.end(), batch.begin(), batch.end());
+    return true;
+}
+
+bool MemoryEngine::Sync() {
+    return true;
+}
+
+std::vector<ClipboardEntry> MemoryEngine::LoadLatest(size_t limit) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = std::min(limit, m_entries.size());
+    return std::vector<ClipboardEntry>(m_entries.rbegin(), m_entries.rbegin() + count);
+}
+
+void MemoryEngine::ForEach(const std::function<bool(const ClipboardEntry&)>& visit) {
+    // Visit a copy so the visitor may call back into the engine
+    std::vector<ClipboardEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries = m_entries;
+    }
+    for (const auto& entry : entries) {
+        if (!visit(entry)) {
+            return;
+        }
+    }
+}
+
+bool MemoryEngine::ReadAt(size_t position, ClipboardEntry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (position >= m_entries.size()) {
+        return false;
+    }
+    entry = m_entries[m_entries.size() - 1 - position];
+    return true;
+}
+
+bool MemoryEngine::FindByTime(std::chrono::system_clock::time_point time, size_t& position) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), time,
+        [](std::chrono::system_clock::time_point value, const ClipboardEntry& entry) { return value < entry.timestamp; });
+    if (it == m_entries.begin()) {
+        return false;
+    }
+    position = static_cast<size_t>(m_entries.end() - it);
+    return true;
+}
+
+StorageStats MemoryEngine::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool MemoryEngine::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_stats = StorageStats();
+    return true;
+}
+
+bool MemoryEngine::Compact(size_t retainEntries, double minSizeRatio) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() <= retainEntries ||
+        (minSizeRatio > 0.0 && m_entries.size() < minSizeRatio * retainEntries)) {
+        return false;
+    }
+
+    m_entries.erase(m_entries.begin(), m_entries.end() - retainEntries);
+    m_stats = StorageStats();
+    for (const auto& entry : m_entries) {
+        CountEntry(m_stats, entry);
+    }
+    return true;
+}
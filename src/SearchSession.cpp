@@ -0,0 +1,71 @@
+#include "SearchSession.h"
+#include "TextEncoding.h"
+#include "TextSearch.h"
+#include <algorithm>
+
+namespace {
+
+// Results kept, counting the one for the empty query
+const size_t kMaxLevels = 16;
+
+} // namespace
+
+SearchSession::SearchSession()
+    : m_depth(0)
+{
+}
+
+const std::vector<size_t>& SearchSession::Update(const HistorySnapshot& snapshot, const std::string& query) {
+    if (m_depth == 0 || !m_snapshot.SameAs(snapshot)) {
+        m_snapshot = snapshot;
+        if (m_levels.empty()) {
+            m_levels.emplace_back();
+        }
+        Level& all = m_levels[0];
+        all.query.clear();
+        all.matches.clear();
+        for (size_t i = 0; i < snapshot.Size(); i++) {
+            all.matches.push_back(i);
+        }
+        m_depth = 1;
+    }
+
+    TextEncoding::LowerCase(query, m_lowerQuery);
+
+    // Drop results for queries this one does not contain. The empty query
+    // at the bottom is contained in every query.
+    while (m_depth > 1 && m_lowerQuery.find(m_levels[m_depth - 1].query) == std::string::npos) {
+        m_depth--;
+    }
+    if (m_levels[m_depth - 1].query == m_lowerQuery) {
+        return m_levels[m_depth - 1].matches;
+    }
+
+    // Full: drop the oldest query, moving its buffers to the end for reuse
+    if (m_depth == kMaxLevels) {
+        std::rotate(m_levels.begin() + 1, m_levels.begin() + 2, m_levels.begin() + m_depth);
+        m_depth--;
+    }
+    if (m_levels.size() == m_depth) {
+        m_levels.emplace_back();
+    }
+
+    // Anything matching this query matched the narrower one below it
+    const Level& from = m_levels[m_depth - 1];
+    Level& next = m_levels[m_depth];
+    next.query = m_lowerQuery;
+    next.matches.clear();
+    TextSearch::Pattern pattern(m_lowerQuery);
+    for (size_t index : from.matches) {
+        if (pattern.Contains(m_snapshot[index].folded)) {
+            next.matches.push_back(index);
+        }
+    }
+    m_depth++;
+    return next.matches;
+}
+
+void SearchSession::Reset() {
+    m_snapshot = HistorySnapshot();
+    m_depth = 0;
+}
@@ -0,0 +1,629 @@
+#include "SegmentedEngine.h"
+#include "Hash.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <limits>
+
+// Manifest layout (all integers little-endian):
+//   Header (16 bytes): magic "CLPM", u32 version, u32 segment count, u32 reserved
+//   Segment (64 bytes): u64 sequence number, i64 oldest / newest timestamp
+//                       (ms since epoch), u64 entry count, u64 payload bytes,
+//                       u64 bytes on disk, u32 text / image / files counts,
+//                       u32 reserved
+//   Trailer:            u32 CRC-32C of everything before it
+//
+// The manifest is replaced (written to "<path>.manifest.tmp", then renamed)
+// whenever a segment is added or dropped, never appended to. A new segment
+// is listed before its file is created and a dropped one is unlisted before
+// its files are deleted, so a crash leaves at worst an unlisted file behind.
+// The counters of the newest segment are only as fresh as the last rewrite;
+// they are reloaded from the segment itself on Open.
+
+namespace {
+
+const char kManifestMagic[4] = { 'C', 'L', 'P', 'M' };
+const uint32_t kManifestVersion = 1;
+const size_t kManifestHeaderSize = 16;
+const size_t kManifestEntrySize = 64;
+const size_t kManifestTrailerSize = 4;
+
+// Sealed segments kept open for reads; the rest are reopened on demand
+const size_t kMaxOpenSegments = 8;
+
+const int64_t kMillisPerDay = 24 * 60 * 60 * 1000;
+
+void PutU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+void PutU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+uint32_t GetU32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+           (static_cast<uint32_t>(u[2]) << 16) | (static_cast<uint32_t>(u[3]) << 24);
+}
+
+uint64_t GetU64(const char* p) {
+    return static_cast<uint64_t>(GetU32(p)) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+int64_t ToEpochMillis(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+void AddStats(StorageStats& total, const StorageStats& stats) {
+    total.entryCount += stats.entryCount;
+    total.payloadBytes += stats.payloadBytes;
+    for (size_t i = 0; i < 3; i++) {
+        total.typeCounts[i] += stats.typeCounts[i];
+    }
+}
+
+// The files that make up one FileEngine log
+const wchar_t* const kSegmentSuffixes[] = { L"", L".idx", L".blobs", L".blobs.idx" };
+
+} // namespace
+
+SegmentedEngine::SegmentedEngine(const std::wstring& path, uint64_t segmentBytes, bool rotateDaily)
+    : m_path(path)
+    , m_segmentBytes(segmentBytes)
+    , m_rotateDaily(rotateDaily)
+    , m_maxAge(0)
+    , m_maxBytes(0)
+    , m_useCounter(0)
+{
+}
+
+SegmentedEngine::~SegmentedEngine() {
+    Close();
+}
+
+std::wstring SegmentedEngine::SegmentPath(uint64_t seq) const {
+    std::wstring number = std::to_wstring(seq);
+    if (number.size() < 6) {
+        number.insert(0, 6 - number.size(), L'0');
+    }
+    return m_path + L"." + number;
+}
+
+std::wstring SegmentedEngine::ManifestPath() const {
+    return m_path + L".manifest";
+}
+
+bool SegmentedEngine::Open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_segments.clear();
+
+    bool found = false;
+    if (!LoadManifest(found)) {
+        std::wcerr << L"Segment manifest at " << ManifestPath() << L" is damaged" << std::endl;
+        return false;
+    }
+    if (!found && !AdoptLog()) {
+        return false;
+    }
+
+    // The manifest's counters for the newest segment may be behind it
+    Segment& active = m_segments.back();
+    std::shared_ptr<FileEngine> engine = OpenSegment(active);
+    if (!engine) {
+        m_segments.clear();
+        return false;
+    }
+    RefreshActive();
+    ClipboardEntry entry;
+    if (active.stats.entryCount > 0 && engine->ReadAt(active.stats.entryCount - 1, entry)) {
+        active.firstMs = ToEpochMillis(entry.timestamp);
+    }
+    if (active.stats.entryCount > 0 && engine->ReadAt(0, entry)) {
+        active.lastMs = ToEpochMillis(entry.timestamp);
+    }
+
+    if (!SaveManifest()) {
+        std::wcerr << L"Failed to write segment manifest at " << ManifestPath() << std::endl;
+        m_segments.clear();
+        return false;
+    }
+
+    ApplyRetention(std::numeric_limits<uint64_t>::max());
+    return true;
+}
+
+void SegmentedEngine::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+        return;
+    }
+
+    SaveManifest();
+    for (auto& segment : m_segments) {
+        if (segment.engine) {
+            segment.engine->Close();
+            segment.engine.reset();
+        }
+    }
+    m_segments.clear();
+}
+
+void SegmentedEngine::SetRetention(std::chrono::hours maxAge, uint64_t maxBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxAge = maxAge;
+    m_maxBytes = maxBytes;
+}
+
+bool SegmentedEngine::Append(const std::vector<ClipboardEntry>& batch, bool sync) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+        return false;
+    }
+    if (batch.empty()) {
+        return true;
+    }
+
+    // A batch always lands in one segment, so rotation is decided by its first entry
+    int64_t firstMs = ToEpochMillis(batch.front().timestamp);
+    RefreshActive();
+    const Segment& current = m_segments.back();
+    bool full = m_segmentBytes > 0 && current.diskBytes >= m_segmentBytes;
+    bool newDay = m_rotateDaily && current.firstMs / kMillisPerDay != firstMs / kMillisPerDay;
+    if (current.stats.entryCount > 0 && (full || newDay) && !Rotate()) {
+        return false;
+    }
+
+    Segment& active = m_segments.back();
+    std::shared_ptr<FileEngine> engine = OpenSegment(active);
+    if (!engine) {
+        return false;
+    }
+
+    bool wasEmpty = active.stats.entryCount == 0;
+    bool ok = engine->Append(batch, sync);
+    RefreshActive();
+    if (active.stats.entryCount > 0) {
+        if (wasEmpty) {
+            active.firstMs = firstMs;
+        }
+        active.lastMs = ToEpochMillis(batch.back().timestamp);
+    }
+    return ok;
+}
+
+bool SegmentedEngine::Sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_segments.empty() && m_segments.back().engine && m_segments.back().engine->Sync();
+}
+
+std::vector<ClipboardEntry> SegmentedEngine::LoadLatest(size_t limit) {
+    std::vector<ClipboardEntry> entries;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RefreshActive();
+
+    // Newest segment first, stopping as soon as limit is reached
+    for (size_t i = m_segments.size(); i-- > 0 && entries.size() < limit;) {
+        if (m_segments[i].stats.entryCount == 0) {
+            continue;
+        }
+        std::shared_ptr<FileEngine> engine = OpenSegment(m_segments[i]);
+        if (!engine) {
+            break;
+        }
+        std::vector<ClipboardEntry> part = engine->LoadLatest(limit - entries.size());
+        entries.insert(entries.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }
+
+    CloseIdleSegments();
+    return entries;
+}
+
+void SegmentedEngine::ForEach(const std::function<bool(const ClipboardEntry&)>& visit) {
+    // Look up the next segment by sequence number under the lock, then read
+    // it without the lock so the writer is not held up by the visitor
+    uint64_t lastSeq = 0;
+    while (true) {
+        std::shared_ptr<FileEngine> engine;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_segments.begin();
+            while (it != m_segments.end() && it->seq <= lastSeq) {
+                ++it;
+            }
+            if (it == m_segments.end()) {
+                return;
+            }
+            lastSeq = it->seq;
+            engine = OpenSegment(*it);
+            CloseIdleSegments();
+        }
+        if (!engine) {
+            return;
+        }
+
+        bool stopped = false;
+        engine->ForEach([&](const ClipboardEntry& entry) {
+            stopped = !visit(entry);
+            return !stopped;
+        });
+        if (stopped) {
+            return;
+        }
+    }
+}
+
+bool SegmentedEngine::ReadAt(size_t position, ClipboardEntry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RefreshActive();
+
+    for (size_t i = m_segments.size(); i-- > 0;) {
+        uint64_t count = m_segments[i].stats.entryCount;
+        if (position < count) {
+            std::shared_ptr<FileEngine> engine = OpenSegment(m_segments[i]);
+            bool found = engine && engine->ReadAt(position, entry);
+            CloseIdleSegments();
+            return found;
+        }
+        position -= static_cast<size_t>(count);
+    }
+    return false;
+}
+
+bool SegmentedEngine::FindByTime(std::chrono::system_clock::time_point time, size_t& position) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RefreshActive();
+
+    // Skip the newer segments that start after time using the manifest
+    // alone; only the segment that covers it is opened
+    int64_t target = ToEpochMillis(time);
+    size_t newer = 0;
+    for (size_t i = m_segments.size(); i-- > 0;) {
+        const Segment& segment = m_segments[i];
+        if (segment.stats.entryCount == 0) {
+            continue;
+        }
+        if (segment.firstMs > target) {
+            newer += static_cast<size_t>(segment.stats.entryCount);
+            continue;
+        }
+
+        std::shared_ptr<FileEngine> engine = OpenSegment(m_segments[i]);
+        size_t local = 0;
+        bool found = engine && engine->FindByTime(time, local);
+        CloseIdleSegments();
+        if (found) {
+            position = newer + local;
+        }
+        return found;
+    }
+    return false;
+}
+
+StorageStats SegmentedEngine::GetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RefreshActive();
+
+    StorageStats total;
+    for (const auto& segment : m_segments) {
+        AddStats(total, segment.stats);
+    }
+    return total;
+}
+
+bool SegmentedEngine::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+        return false;
+    }
+
+    // Start a fresh segment, then drop every one before it
+    Segment fresh = { m_segments.back().seq + 1, 0, 0, StorageStats(), 0, nullptr, 0 };
+    m_segments.push_back(fresh);
+    if (!DropSegments(m_segments.size() - 1)) {
+        m_segments.pop_back();
+        return false;
+    }
+    return OpenSegment(m_segments.back()) != nullptr;
+}
+
+bool SegmentedEngine::Compact(size_t retainEntries, double minSizeRatio) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_segments.empty()) {
+        return false;
+    }
+    RefreshActive();
+
+    uint64_t total = 0;
+    for (const auto& segment : m_segments) {
+        total += segment.stats.entryCount;
+    }
+
+    // Below the ratio only the age and size limits apply
+    uint64_t retain = retainEntries;
+    if (minSizeRatio > 0.0 && static_cast<double>(total) < static_cast<double>(retainEntries) * minSizeRatio) {
+        retain = std::numeric_limits<uint64_t>::max();
+    }
+    return ApplyRetention(retain);
+}
+
+bool SegmentedEngine::LoadManifest(bool& found) {
+    std::error_code ec;
+    found = std::filesystem::exists(std::filesystem::path(ManifestPath()), ec);
+    if (!found) {
+        return true;
+    }
+
+    std::ifstream file(std::filesystem::path(ManifestPath()), std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < kManifestHeaderSize + kManifestTrailerSize ||
+        !std::equal(kManifestMagic, kManifestMagic + sizeof(kManifestMagic), data.data()) ||
+        GetU32(data.data() + 4) > kManifestVersion) {
+        return false;
+    }
+
+    size_t count = GetU32(data.data() + 8);
+    size_t crcOffset = kManifestHeaderSize + count * kManifestEntrySize;
+    if (count == 0 || data.size() != crcOffset + kManifestTrailerSize ||
+        GetU32(data.data() + crcOffset) != Hash::Crc32c(data.data(), crcOffset)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char* p = data.data() + kManifestHeaderSize + i * kManifestEntrySize;
+        Segment segment = { GetU64(p), static_cast<int64_t>(GetU64(p + 8)), static_cast<int64_t>(GetU64(p + 16)),
+                            StorageStats(), GetU64(p + 40), nullptr, 0 };
+        segment.stats.entryCount = GetU64(p + 24);
+        segment.stats.payloadBytes = GetU64(p + 32);
+        for (size_t type = 0; type < 3; type++) {
+            segment.stats.typeCounts[type] = GetU32(p + 48 + type * 4);
+        }
+        m_segments.push_back(segment);
+    }
+    return true;
+}
+
+bool SegmentedEngine::SaveManifest() {
+    RefreshActive();
+
+    std::string data(kManifestMagic, sizeof(kManifestMagic));
+    PutU32(data, kManifestVersion);
+    PutU32(data, static_cast<uint32_t>(m_segments.size()));
+    PutU32(data, 0);
+    for (const auto& segment : m_segments) {
+        PutU64(data, segment.seq);
+        PutU64(data, static_cast<uint64_t>(segment.firstMs));
+        PutU64(data, static_cast<uint64_t>(segment.lastMs));
+        PutU64(data, segment.stats.entryCount);
+        PutU64(data, segment.stats.payloadBytes);
+        PutU64(data, segment.diskBytes);
+        for (uint64_t count : segment.stats.typeCounts) {
+            PutU32(data, static_cast<uint32_t>(count));
+        }
+        PutU32(data, 0);
+    }
+    PutU32(data, Hash::Crc32c(data.data(), data.size()));
+
+    std::wstring tempPath = ManifestPath() + L".tmp";
+    LogFile temp;
+    bool ok = temp.Open(tempPath) && temp.Truncate(0) && temp.Append(data.data(), data.size()) && temp.Sync();
+    temp.Close();
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(std::filesystem::path(tempPath), std::filesystem::path(ManifestPath()), ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        std::filesystem::remove(std::filesystem::path(tempPath), ec);
+    }
+    return ok;
+}
+
+std::shared_ptr<FileEngine> SegmentedEngine::OpenSegment(Segment& segment) {
+    segment.lastUsed = ++m_useCounter;
+    if (!segment.engine) {
+        auto engine = std::make_shared<FileEngine>(SegmentPath(segment.seq));
+        if (!engine->Open()) {
+            std::wcerr << L"Failed to open storage segment " << SegmentPath(segment.seq) << std::endl;
+            return nullptr;
+        }
+        segment.engine = engine;
+    }
+    return segment.engine;
+}
+
+void SegmentedEngine::CloseIdleSegments() {
+    // The segment being written stays open; of the sealed ones, close the
+    // least recently used past kMaxOpenSegments
+    while (true) {
+        size_t open = 0;
+        Segment* idlest = nullptr;
+        for (size_t i = 0; i + 1 < m_segments.size(); i++) {
+            Segment& segment = m_segments[i];
+            if (!segment.engine) {
+                continue;
+            }
+            open++;
+            if (!idlest || segment.lastUsed < idlest->lastUsed) {
+                idlest = &segment;
+            }
+        }
+        if (open <= kMaxOpenSegments) {
+            return;
+        }
+        idlest->engine.reset();
+    }
+}
+
+void SegmentedEngine::RefreshActive() {
+    if (m_segments.empty() || !m_segments.back().engine) {
+        return;
+    }
+    Segment& active = m_segments.back();
+    active.stats = active.engine->GetStats();
+    active.diskBytes = active.engine->DiskSize();
+}
+
+bool SegmentedEngine::Rotate() {
+    // Seal the current segment: its data reaches disk before the manifest
+    // moves past it
+    Segment& sealed = m_segments.back();
+    if (!sealed.engine || !sealed.engine->Sync()) {
+        return false;
+    }
+    RefreshActive();
+
+    Segment next = { sealed.seq + 1, 0, 0, StorageStats(), 0, nullptr, 0 };
+    m_segments.push_back(next);
+    if (!SaveManifest()) {
+        std::wcerr << L"Failed to write segment manifest at " << ManifestPath() << std::endl;
+        m_segments.pop_back();
+        return false;
+    }
+
+    CloseIdleSegments();
+    return OpenSegment(m_segments.back()) != nullptr;
+}
+
+bool SegmentedEngine::DropSegments(size_t count) {
+    std::vector<Segment> dropped(m_segments.begin(), m_segments.begin() + count);
+    m_segments.erase(m_segments.begin(), m_segments.begin() + count);
+    if (!SaveManifest()) {
+        std::wcerr << L"Failed to write segment manifest at " << ManifestPath() << std::endl;
+        m_segments.insert(m_segments.begin(), dropped.begin(), dropped.end());
+        return false;
+    }
+
+    // A reader still holding a dropped segment keeps it open until it is
+    // done; on Windows its files then stay behind, unlisted
+    for (auto& segment : dropped) {
+        segment.engine.reset();
+        for (const wchar_t* suffix : kSegmentSuffixes) {
+            std::error_code ec;
+            std::filesystem::remove(std::filesystem::path(SegmentPath(segment.seq) + suffix), ec);
+        }
+    }
+    return true;
+}
+
+bool SegmentedEngine::ApplyRetention(uint64_t retainEntries) {
+    RefreshActive();
+
+    uint64_t totalEntries = 0;
+    uint64_t totalBytes = 0;
+    for (const auto& segment : m_segments) {
+        totalEntries += segment.stats.entryCount;
+        totalBytes += segment.diskBytes;
+    }
+
+    int64_t cutoff = ToEpochMillis(std::chrono::system_clock::now()) -
+        std::chrono::duration_cast<std::chrono::milliseconds>(m_maxAge).count();
+
+    size_t drop = 0;
+    uint64_t droppedEntries = 0;
+    while (drop + 1 < m_segments.size()) {
+        const Segment& segment = m_segments[drop];
+        bool empty = segment.stats.entryCount == 0;
+        bool expired = m_maxAge.count() > 0 && segment.lastMs < cutoff;
+        bool overBudget = m_maxBytes > 0 && totalBytes > m_maxBytes;
+        bool surplus = totalEntries - segment.stats.entryCount >= retainEntries;
+        if (!empty && !expired && !overBudget && !surplus) {
+            break;
+        }
+        totalEntries -= segment.stats.entryCount;
+        totalBytes -= segment.diskBytes;
+        droppedEntries += segment.stats.entryCount;
+        drop++;
+    }
+
+    bool changed = false;
+    if (drop > 0 && DropSegments(drop)) {
+        std::wcout << L"Dropped " << drop << L" storage segments (" << droppedEntries << L" entries)" << std::endl;
+        changed = true;
+    }
+
+    // Dropping whole segments stops short of the limits by up to one
+    // segment; trim the oldest one left down to what they keep
+    Segment& oldest = m_segments.front();
+    uint64_t count = oldest.stats.entryCount;
+    uint64_t keep = count;
+    if (totalEntries > retainEntries) {
+        keep -= std::min(keep, totalEntries - retainEntries);
+    }
+    if (m_maxAge.count() > 0 && count > 0 && oldest.firstMs < cutoff) {
+        std::shared_ptr<FileEngine> engine = OpenSegment(oldest);
+        size_t newer = 0;
+        auto cutoffTime = std::chrono::system_clock::time_point(std::chrono::milliseconds(cutoff));
+        if (engine && engine->FindByTime(cutoffTime, newer)) {
+            keep = std::min<uint64_t>(keep, newer);
+        }
+    }
+    if (keep > 0 && keep < count && TrimSegment(oldest, keep)) {
+        std::wcout << L"Trimmed storage segment " << SegmentPath(oldest.seq) << L" to " << keep
+                   << L" entries" << std::endl;
+        changed = true;
+    }
+    CloseIdleSegments();
+    return changed;
+}
+
+bool SegmentedEngine::TrimSegment(Segment& segment, uint64_t keep) {
+    std::shared_ptr<FileEngine> engine = OpenSegment(segment);
+    if (!engine || !engine->Compact(static_cast<size_t>(keep), 0.0)) {
+        return false;
+    }
+
+    segment.stats = engine->GetStats();
+    segment.diskBytes = engine->DiskSize();
+    ClipboardEntry entry;
+    if (segment.stats.entryCount > 0 && engine->ReadAt(segment.stats.entryCount - 1, entry)) {
+        segment.firstMs = ToEpochMillis(entry.timestamp);
+    }
+    if (!SaveManifest()) {
+        std::wcerr << L"Failed to write segment manifest at " << ManifestPath() << std::endl;
+    }
+    return true;
+}
+
+size_t SegmentedEngine::GetOpenSegmentCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t open = 0;
+    for (const auto& segment : m_segments) {
+        if (segment.engine) {
+            open++;
+        }
+    }
+    return open;
+}
+
+bool SegmentedEngine::AdoptLog() {
+    Segment first = { 1, 0, 0, StorageStats(), 0, nullptr, 0 };
+
+    std::error_code ec;
+    std::filesystem::path log(m_path);
+    if (std::filesystem::exists(log, ec) && std::filesystem::file_size(log, ec) > 0) {
+        // Move the log and its sidecars over; the log id inside ties them
+        // together, not their names
+        for (const wchar_t* suffix : kSegmentSuffixes) {
+            std::filesystem::path from(m_path + suffix);
+            if (!std::filesystem::exists(from, ec)) {
+                continue;
+            }
+            std::filesystem::rename(from, std::filesystem::path(SegmentPath(first.seq) + suffix), ec);
+            if (ec) {
+                std::wcerr << L"Failed to move " << from.wstring() << L" into a storage segment" << std::endl;
+                return false;
+            }
+        }
+        std::wcout << L"Moved the log at " << m_path << L" into segment " << SegmentPath(first.seq) << std::endl;
+    }
+
+    m_segments.push_back(first);
+    return true;
+}
@@ -0,0 +1,535 @@
+#include "SqliteEngine.h"
+#include "FileEngine.h"
+#include "TextEncoding.h"
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+
+// StorageEngine over SQLite.
+//
+// Entries live in one table in WAL mode. Inserts, loads and lookups go
+// through statements prepared once at open, and each appended batch is
+// inserted inside a single transaction. Compaction only ever deletes the
+// oldest rows, so row ids stay contiguous and position N from the newest
+// entry is simply max(id) - N.
+//
+// Built only when CLIPPY2000_HAVE_SQLITE is defined; otherwise the engine
+// reports itself unavailable.
+
+SqliteEngine::SqliteEngine(const std::wstring& path)
+    : m_path(path)
+    , m_syncPolicy(SyncPolicy::Interval)
+    , m_db(nullptr)
+    , m_sql(nullptr)
+{
+}
+
+SqliteEngine::~SqliteEngine() {
+    Close();
+}
+
+StorageStats SqliteEngine::GetStats() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+#ifdef CLIPPY2000_HAVE_SQLITE
+
+#include <sqlite3.h>
+
+struct SqliteEngine::Statements {
+    sqlite3_stmt* begin = nullptr;
+    sqlite3_stmt* commit = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_stmt* loadLatest = nullptr;
+    sqlite3_stmt* readAt = nullptr;
+    sqlite3_stmt* findByTime = nullptr;
+    sqlite3_stmt* trimOldest = nullptr;
+    sqlite3_stmt* clear = nullptr;
+};
+
+namespace {
+
+const char kSqliteMagic[16] = { 'S', 'Q', 'L', 'i', 't', 'e', ' ', 'f', 'o', 'r', 'm', 'a', 't', ' ', '3', '\0' };
+
+const char* kSchema =
+    "CREATE TABLE IF NOT EXISTS entries ("
+    "  id INTEGER PRIMARY KEY,"
+    "  type INTEGER NOT NULL,"
+    "  timestamp INTEGER NOT NULL,"
+    "  text TEXT NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS entries_timestamp ON entries(timestamp);"
+    "CREATE TABLE IF NOT EXISTS meta ("
+    "  key TEXT PRIMARY KEY,"
+    "  value INTEGER NOT NULL);";
+
+// Set in the same transaction as the rows imported from a flat log, so a
+// flat log that outlives its import is not imported twice
+const char* kFlatImportedKey = "flat_imported";
+
+// A flat log and the sidecars the file backend keeps next to it
+const wchar_t* const kFlatLogSuffixes[] = { L"", L".idx", L".blobs" };
+
+sqlite3* Db(void* db) {
+    return static_cast<sqlite3*>(db);
+}
+
+bool Prepare(sqlite3* db, const char* sql, sqlite3_stmt** stmt) {
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, nullptr) != SQLITE_OK) {
+        std::wcerr << L"SQLite prepare failed: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Step a statement that returns no rows, then reset it for reuse
+bool Run(sqlite3_stmt* stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE;
+}
+
+ClipboardDataType ToDataType(int value) {
+    switch (value) {
+        case static_cast<int>(ClipboardDataType::Files): return ClipboardDataType::Files;
+        case static_cast<int>(ClipboardDataType::Image): return ClipboardDataType::Image;
+        default: return ClipboardDataType::Text;
+    }
+}
+
+// Read (type, timestamp, text) from the current row
+ClipboardEntry ReadRow(sqlite3_stmt* stmt) {
+    ClipboardEntry entry;
+    entry.type = ToDataType(sqlite3_column_int(stmt, 0));
+    entry.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::milliseconds(sqlite3_column_int64(stmt, 1))));
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    entry.text.assign(text ? text : "", static_cast<size_t>(sqlite3_column_bytes(stmt, 2)));
+    return entry;
+}
+
+int64_t ToEpochMillis(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+// Recount entries, payload bytes and per-type counts from the table
+bool LoadTotals(sqlite3* db, StorageStats& stats) {
+    sqlite3_stmt* totals = nullptr;
+    if (!Prepare(db, "SELECT type, count(*), sum(length(CAST(text AS BLOB))) FROM entries GROUP BY type", &totals)) {
+        return false;
+    }
+
+    stats = StorageStats();
+    while (sqlite3_step(totals) == SQLITE_ROW) {
+        uint64_t count = static_cast<uint64_t>(sqlite3_column_int64(totals, 1));
+        stats.typeCounts[static_cast<size_t>(ToDataType(sqlite3_column_int(totals, 0)))] += count;
+        stats.entryCount += count;
+        stats.payloadBytes += static_cast<uint64_t>(sqlite3_column_int64(totals, 2));
+    }
+    return sqlite3_finalize(totals) == SQLITE_OK;
+}
+
+bool HasMeta(sqlite3* db, const char* key) {
+    sqlite3_stmt* stmt = nullptr;
+    if (!Prepare(db, "SELECT value FROM meta WHERE key = ?", &stmt)) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) != 0;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Move the flat log at from, with its sidecars, to to. Either all of them
+// move or none do.
+bool MoveFlatLog(const std::wstring& from, const std::wstring& to) {
+    std::error_code ec;
+    if (std::filesystem::exists(std::filesystem::path(to), ec)) {
+        std::wcerr << L"Cannot move the flat log at " << from << L" aside: " << to
+                   << L" is still waiting to be imported" << std::endl;
+        return false;
+    }
+
+    size_t moved = 0;
+    for (; moved < sizeof(kFlatLogSuffixes) / sizeof(kFlatLogSuffixes[0]); moved++) {
+        std::filesystem::path source(from + kFlatLogSuffixes[moved]);
+        if (moved > 0 && !std::filesystem::exists(source, ec)) {
+            continue;
+        }
+        std::filesystem::rename(source, std::filesystem::path(to + kFlatLogSuffixes[moved]), ec);
+        if (ec) {
+            break;
+        }
+    }
+    if (moved == sizeof(kFlatLogSuffixes) / sizeof(kFlatLogSuffixes[0])) {
+        return true;
+    }
+
+    std::wcerr << L"Failed to move " << from << kFlatLogSuffixes[moved] << L" aside for import" << std::endl;
+    while (moved-- > 0) {
+        std::filesystem::path target(to + kFlatLogSuffixes[moved]);
+        if (std::filesystem::exists(target, ec)) {
+            std::filesystem::rename(target, std::filesystem::path(from + kFlatLogSuffixes[moved]), ec);
+        }
+    }
+    return false;
+}
+
+bool IsSqliteFile(const std::filesystem::path& path) {
+    char header[sizeof(kSqliteMagic)] = {0};
+    std::ifstream file(path, std::ios::binary);
+    file.read(header, sizeof(header));
+    return file && std::equal(header, header + sizeof(header), kSqliteMagic);
+}
+
+} // namespace
+
+bool SqliteEngine::Open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::filesystem::path path(m_path);
+    std::error_code ec;
+
+    // A flat log left at this path by the file backend is moved aside, then
+    // imported into the new database below
+    std::wstring importPath = m_path + L".flat";
+    if (std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > 0 && !IsSqliteFile(path) &&
+        !MoveFlatLog(m_path, importPath)) {
+        return false;
+    }
+
+    sqlite3* db = nullptr;
+    std::string utf8Path = TextEncoding::WideToUtf8(m_path);
+    if (sqlite3_open_v2(utf8Path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        std::wcerr << L"Failed to open SQLite database: " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+        sqlite3_close(db);
+        return false;
+    }
+    m_db = db;
+
+    const char* synchronous = "PRAGMA synchronous=NORMAL;";
+    if (m_syncPolicy == SyncPolicy::None) {
+        synchronous = "PRAGMA synchronous=OFF;";
+    } else if (m_syncPolicy == SyncPolicy::PerBatch) {
+        synchronous = "PRAGMA synchronous=FULL;";
+    }
+
+    m_sql = new Statements();
+    bool ok = sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_exec(db, synchronous, nullptr, nullptr, nullptr) == SQLITE_OK &&
+              sqlite3_exec(db, kSchema, nullptr, nullptr, nullptr) == SQLITE_OK &&
+              Prepare(db, "BEGIN", &m_sql->begin) &&
+              Prepare(db, "COMMIT", &m_sql->commit) &&
+              Prepare(db, "INSERT INTO entries (type, timestamp, text) VALUES (?, ?, ?)", &m_sql->insert) &&
+              Prepare(db, "SELECT type, timestamp, text FROM entries ORDER BY id DESC LIMIT ?", &m_sql->loadLatest) &&
+              Prepare(db, "SELECT type, timestamp, text FROM entries "
+                          "WHERE id = (SELECT max(id) FROM entries) - ?", &m_sql->readAt) &&
+              Prepare(db, "SELECT (SELECT max(id) FROM entries) - id FROM entries "
+                          "WHERE timestamp <= ? ORDER BY timestamp DESC, id DESC LIMIT 1", &m_sql->findByTime) &&
+              Prepare(db, "DELETE FROM entries WHERE id <= (SELECT max(id) FROM entries) - ?", &m_sql->trimOldest) &&
+              Prepare(db, "DELETE FROM entries", &m_sql->clear);
+    if (!ok) {
+        std::wcerr << L"Failed to set up SQLite database: " << sqlite3_errmsg(db) << std::endl;
+        CloseDatabase();
+        return false;
+    }
+
+    // Also retries an import that an earlier Open did not finish
+    if (std::filesystem::exists(std::filesystem::path(importPath), ec) && !ImportFlatLog(importPath)) {
+        CloseDatabase();
+        return false;
+    }
+
+    // Count once at open; inserts keep the counters current after this
+    StorageStats stats;
+    if (!LoadTotals(db, stats)) {
+        CloseDatabase();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+    m_stats = stats;
+    return true;
+}
+
+void SqliteEngine::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CloseDatabase();
+}
+
+void SqliteEngine::SetSyncPolicy(SyncPolicy policy) {
+    m_syncPolicy = policy;
+}
+
+void SqliteEngine::CloseDatabase() {
+    // Caller holds m_mutex
+    if (m_sql) {
+        for (sqlite3_stmt* stmt : { m_sql->begin, m_sql->commit, m_sql->insert, m_sql->loadLatest,
+                                    m_sql->readAt, m_sql->findByTime, m_sql->trimOldest, m_sql->clear }) {
+            sqlite3_finalize(stmt);
+        }
+        delete m_sql;
+        m_sql = nullptr;
+    }
+    if (m_db) {
+        sqlite3_close(Db(m_db));
+        m_db = nullptr;
+    }
+}
+
+bool SqliteEngine::Append(const std::vector<ClipboardEntry>& batch, bool sync) {
+    // PRAGMA synchronous already matches the sync policy
+    (void)sync;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sql && Insert(batch);
+}
+
+bool SqliteEngine::InsertRow(const ClipboardEntry& entry) {
+    // Caller holds m_mutex and has begun a transaction
+    sqlite3_bind_int(m_sql->insert, 1, static_cast<int>(entry.type));
+    sqlite3_bind_int64(m_sql->insert, 2, ToEpochMillis(entry.timestamp));
+    sqlite3_bind_text(m_sql->insert, 3, entry.text.data(), static_cast<int>(entry.text.size()), SQLITE_STATIC);
+    bool ok = Run(m_sql->insert);
+    sqlite3_clear_bindings(m_sql->insert);
+    return ok;
+}
+
+bool SqliteEngine::Insert(const std::vector<ClipboardEntry>& batch) {
+    // Caller holds m_mutex
+    StorageStats added;
+    bool ok = Run(m_sql->begin);
+    for (size_t i = 0; ok && i < batch.size(); i++) {
+        const ClipboardEntry& entry = batch[i];
+        ok = InsertRow(entry);
+
+        added.entryCount++;
+        added.payloadBytes += entry.text.size();
+        added.typeCounts[static_cast<size_t>(entry.type)]++;
+    }
+
+    if (!ok || !Run(m_sql->commit)) {
+        sqlite3_exec(Db(m_db), "ROLLBACK", nullptr, nullptr, nullptr);
+        std::wcerr << L"Failed to write " << batch.size() << L" entries to SQLite: "
+                   << sqlite3_errmsg(Db(m_db)) << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+    m_stats.entryCount += added.entryCount;
+    m_stats.payloadBytes += added.payloadBytes;
+    for (size_t i = 0; i < 3; i++) {
+        m_stats.typeCounts[i] += added.typeCounts[i];
+    }
+    return true;
+}
+
+bool SqliteEngine::ImportFlatLog(const std::wstring& importPath) {
+    // Caller holds m_mutex; the counters are loaded after this
+    sqlite3* db = Db(m_db);
+    if (!HasMeta(db, kFlatImportedKey)) {
+        // The file engine reads (and if needed upgrades) whatever format
+        // the flat log was left in
+        FileEngine flat(importPath);
+        if (!flat.Open()) {
+            std::wcerr << L"Failed to open " << importPath << L" for import; it is kept for the next start" << std::endl;
+            return false;
+        }
+
+        // All rows and the imported mark commit together or not at all
+        size_t imported = 0;
+        bool ok = Run(m_sql->begin);
+        // Entries the flat log keeps in its blob store are read as they go
+        flat.ForEach([&](const ClipboardEntry& entry) {
+            ClipboardEntry loaded = entry;
+            loaded.LoadText();
+            ok = InsertRow(loaded);
+            imported += ok ? 1 : 0;
+            return ok;
+        });
+        flat.Close();
+
+        std::string mark = std::string("INSERT OR REPLACE INTO meta (key, value) VALUES ('") + kFlatImportedKey + "', 1)";
+        if (!ok || sqlite3_exec(db, mark.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK || !Run(m_sql->commit)) {
+            std::wcerr << L"Failed to import " << importPath << L": " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+            return false;
+        }
+        std::wcout << L"Imported " << imported << L" entries from " << importPath << std::endl;
+    }
+
+    // Only once the import is committed can the flat log go. If this fails
+    // the mark keeps the next start from importing it again.
+    std::error_code ec;
+    for (const wchar_t* suffix : kFlatLogSuffixes) {
+        std::filesystem::remove(std::filesystem::path(importPath + suffix), ec);
+        if (ec) {
+            std::wcerr << L"Failed to remove " << importPath << suffix << L" after importing it" << std::endl;
+        }
+    }
+    return true;
+}
+
+bool SqliteEngine::Sync() {
+    // Checkpointing syncs the WAL and folds it back into the main database file
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_db && sqlite3_wal_checkpoint_v2(Db(m_db), nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr) == SQLITE_OK;
+}
+
+std::vector<ClipboardEntry> SqliteEngine::LoadLatest(size_t limit) {
+    std::vector<ClipboardEntry> entries;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_sql) {
+        return entries;
+    }
+
+    sqlite3_bind_int64(m_sql->loadLatest, 1, static_cast<sqlite3_int64>(limit));
+    while (sqlite3_step(m_sql->loadLatest) == SQLITE_ROW) {
+        entries.push_back(ReadRow(m_sql->loadLatest));
+    }
+    sqlite3_reset(m_sql->loadLatest);
+    return entries;
+}
+
+void SqliteEngine::ForEach(const std::function<bool(const ClipboardEntry&)>& visit) {
+    // Read in pages by row id, so the connection is not held while visiting
+    sqlite3_int64 lastId = 0;
+    while (true) {
+        std::vector<std::pair<sqlite3_int64, ClipboardEntry>> page;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            sqlite3_stmt* stmt = nullptr;
+            if (!m_sql || !Prepare(Db(m_db), "SELECT type, timestamp, text, id FROM entries "
+                                              "WHERE id > ? ORDER BY id LIMIT 256", &stmt)) {
+                return;
+            }
+            sqlite3_bind_int64(stmt, 1, lastId);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                page.emplace_back(sqlite3_column_int64(stmt, 3), ReadRow(stmt));
+            }
+            sqlite3_finalize(stmt);
+        }
+
+        if (page.empty()) {
+            return;
+        }
+        for (const auto& row : page) {
+            if (!visit(row.second)) {
+                return;
+            }
+        }
+        lastId = page.back().first;
+    }
+}
+
+bool SqliteEngine::ReadAt(size_t position, ClipboardEntry& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_sql) {
+        return false;
+    }
+
+    sqlite3_bind_int64(m_sql->readAt, 1, static_cast<sqlite3_int64>(position));
+    bool found = sqlite3_step(m_sql->readAt) == SQLITE_ROW;
+    if (found) {
+        entry = ReadRow(m_sql->readAt);
+    }
+    sqlite3_reset(m_sql->readAt);
+    return found;
+}
+
+bool SqliteEngine::FindByTime(std::chrono::system_clock::time_point time, size_t& position) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_sql) {
+        return false;
+    }
+
+    sqlite3_bind_int64(m_sql->findByTime, 1, ToEpochMillis(time));
+    bool found = sqlite3_step(m_sql->findByTime) == SQLITE_ROW;
+    if (found) {
+        position = static_cast<size_t>(sqlite3_column_int64(m_sql->findByTime, 0));
+    }
+    sqlite3_reset(m_sql->findByTime);
+    return found;
+}
+
+bool SqliteEngine::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_sql || !Run(m_sql->clear)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+    m_stats = StorageStats();
+    return true;
+}
+
+bool SqliteEngine::Compact(size_t retainEntries, double minSizeRatio) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint64_t count = GetStats().entryCount;
+    if (!m_sql || count <= retainEntries || (minSizeRatio > 0.0 && count < minSizeRatio * retainEntries)) {
+        return false;
+    }
+
+    sqlite3_bind_int64(m_sql->trimOldest, 1, static_cast<sqlite3_int64>(retainEntries));
+    if (!Run(m_sql->trimOldest)) {
+        return false;
+    }
+
+    // Recount what is left; a retention trim is rare enough to afford it
+    StorageStats stats;
+    if (!LoadTotals(Db(m_db), stats)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> statsLock(m_statsMutex);
+    std::wcout << L"Compacted storage: kept " << stats.entryCount << L" of " << m_stats.entryCount << L" entries" << std::endl;
+    m_stats = stats;
+    return true;
+}
+
+#else
+
+bool SqliteEngine::Open() {
+    std::wcerr << L"This build does not include the SQLite storage engine" << std::endl;
+    return false;
+}
+
+void SqliteEngine::Close() {
+}
+
+void SqliteEngine::SetSyncPolicy(SyncPolicy policy) {
+    m_syncPolicy = policy;
+}
+
+bool SqliteEngine::Append(const std::vector<ClipboardEntry>&, bool) {
+    return false;
+}
+
+bool SqliteEngine::Sync() {
+    return false;
+}
+
+std::vector<ClipboardEntry> SqliteEngine::LoadLatest(size_t) {
+    return {};
+}
+
+void SqliteEngine::ForEach(const std::function<bool(const ClipboardEntry&)>&) {
+}
+
+bool SqliteEngine::ReadAt(size_t, ClipboardEntry&) {
+    return false;
+}
+
+bool SqliteEngine::FindByTime(std::chrono::system_clock::time_point, size_t&) {
+    return false;
+}
+
+bool SqliteEngine::Clear() {
+    return false;
+}
+
+bool SqliteEngine::Compact(size_t, double) {
+    return false;
+}
+
+#endif
@@ -1,168 +1,307 @@
 #include "Storage.h"
+#include "FileEngine.h"
+#include "MappedEngine.h"
+#include "MemoryEngine.h"
+#include "SegmentedEngine.h"
+#include "SqliteEngine.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
-#include <ctime>
+#include <algorithm>
 
-// Simple file-based storage implementation
-// TODO: Replace with SQLite for better performance and querying
+namespace {
 
-Storage::Storage(const std::wstring& dbPath)
-    : m_dbPath(dbPath)
-    , m_db(nullptr)
+// Once capture has gone quiet a smaller surplus is worth rewriting than
+// while it is busy, but not a handful of records
+const double kIdleCompactRatio = 1.5;
+
+std::unique_ptr<StorageEngine> CreateEngine(const std::wstring& path, StorageBackend backend) {
+    switch (backend) {
+    case StorageBackend::Mapped:
+        return std::make_unique<MappedEngine>(path);
+    case StorageBackend::Segmented:
+        return std::make_unique<SegmentedEngine>(path);
+    case StorageBackend::Memory:
+        return std::make_unique<MemoryEngine>();
+    case StorageBackend::Sqlite:
+        return std::make_unique<SqliteEngine>(path);
+    case StorageBackend::File:
+    default:
+        return std::make_unique<FileEngine>(path);
+    }
+}
+
+} // namespace
+
+Storage::Storage(const std::wstring& dbPath, StorageBackend backend)
+    : Storage(CreateEngine(dbPath, backend))
+{
+}
+
+Storage::Storage(std::unique_ptr<StorageEngine> engine)
+    : m_engine(std::move(engine))
+    , m_writing(false)
+    , m_stopping(false)
+    , m_unsynced(false)
+    , m_syncPolicy(SyncPolicy::Interval)
+    , m_syncInterval(1000)
+    , m_retainEntries(100)
+    , m_compactRatio(4.0)
+    , m_compactIdle(300)
+    , m_compactRequested(false)
+    , m_version(0)
+    , m_epoch(0)
 {
 }
 
 Storage::~Storage() {
+    Shutdown();
 }
 
 bool Storage::Initialize() {
-    // For now, just check if we can create/access the file
-    std::wofstream test(m_dbPath, std::ios::app);
-    if (!test) {
-        std::wcerr << L"Failed to initialize storage at: " << m_dbPath << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_engine->SetSyncPolicy(m_syncPolicy);
+    }
+    if (!m_engine->Open()) {
+        std::wcerr << L"Failed to initialize storage" << std::endl;
         return false;
     }
-    test.close();
 
-    std::wcout << L"Storage initialized at: " << m_dbPath << std::endl;
+    m_stopping = false;
+    m_writer = std::thread(&Storage::WriterLoop, this);
+
+    std::wcout << L"Storage initialized" << std::endl;
     return true;
 }
 
+void Storage::SetSyncPolicy(SyncPolicy policy, unsigned intervalMs) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_syncPolicy = policy;
+    m_syncInterval = std::chrono::milliseconds(intervalMs);
+    m_queueCv.notify_one();
+}
+
 bool Storage::SaveEntry(const ClipboardEntry& entry) {
-    std::wofstream file(m_dbPath, std::ios::app);
-    if (!file) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (!m_writer.joinable() || m_stopping) {
         return false;
     }
 
-    // Get timestamp as epoch
-    auto epoch = std::chrono::system_clock::to_time_t(entry.timestamp);
-
-    // Format: timestamp|type|text
-    // Escape newlines and pipe characters in text
-    std::wstring escapedText = entry.text;
-    size_t pos = 0;
-    while ((pos = escapedText.find(L'\n', pos)) != std::wstring::npos) {
-        escapedText.replace(pos, 1, L"\\n");
-        pos += 2;
-    }
-    pos = 0;
-    while ((pos = escapedText.find(L'|', pos)) != std::wstring::npos) {
-        escapedText.replace(pos, 1, L"\\p");
-        pos += 2;
-    }
-
-    file << epoch << L"|" << static_cast<int>(entry.type) << L"|" << escapedText << L"\n";
-    file.close();
+    m_queue.push_back(entry);
+    m_queueCv.notify_one();
     return true;
 }
 
-std::vector<ClipboardEntry> Storage::LoadEntries(size_t limit) {
-    std::vector<ClipboardEntry> entries;
-    std::wifstream file(m_dbPath);
+void Storage::Flush() {
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    m_drainedCv.wait(lock, [this]() { return m_queue.empty() && !m_writing; });
+}
 
-    if (!file) {
-        return entries;
+void Storage::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_writer.joinable()) {
+            return;
+        }
+        m_stopping = true;
+        m_queueCv.notify_one();
     }
 
-    std::wstring line;
-    while (std::getline(file, line) && entries.size() < limit) {
-        // Parse: timestamp|type|text
-        size_t firstPipe = line.find(L'|');
-        if (firstPipe == std::wstring::npos) {
-            continue;
-        }
+    // The writer drains the queue before it exits
+    m_writer.join();
+
+    if (m_syncPolicy != SyncPolicy::None && m_unsynced) {
+        SyncFile();
+    }
+    m_engine->Close();
+}
+
+void Storage::WriterLoop() {
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    auto lastSync = std::chrono::steady_clock::now();
+    auto lastWrite = lastSync;
+    bool wroteSinceCompaction = false;
 
-        size_t secondPipe = line.find(L'|', firstPipe + 1);
+    while (true) {
+        auto hasWork = [this]() { return !m_queue.empty() || m_stopping || m_compactRequested; };
 
-        ClipboardEntry entry;
-        std::wstring timestampStr;
-        std::wstring typeStr;
-        std::wstring text;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        if (m_syncPolicy == SyncPolicy::Interval && m_unsynced) {
+            deadline = lastSync + m_syncInterval;
+        }
+        if (wroteSinceCompaction) {
+            deadline = std::min(deadline, lastWrite + m_compactIdle);
+        }
 
-        if (secondPipe == std::wstring::npos) {
-            // Old format: timestamp|text (no type)
-            timestampStr = line.substr(0, firstPipe);
-            text = line.substr(firstPipe + 1);
-            entry.type = ClipboardDataType::Text; // Default to text for old entries
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            m_queueCv.wait(lock, hasWork);
         } else {
-            // New format: timestamp|type|text
-            timestampStr = line.substr(0, firstPipe);
-            typeStr = line.substr(firstPipe + 1, secondPipe - firstPipe - 1);
-            text = line.substr(secondPipe + 1);
-
-            // Parse type
-            try {
-                int typeInt = std::stoi(typeStr);
-                entry.type = static_cast<ClipboardDataType>(typeInt);
-            } catch (...) {
-                entry.type = ClipboardDataType::Text;
-            }
+            m_queueCv.wait_until(lock, deadline, hasWork);
         }
 
-        // Unescape text
-        size_t pos = 0;
-        while ((pos = text.find(L"\\n", pos)) != std::wstring::npos) {
-            text.replace(pos, 2, L"\n");
-            pos += 1;
+        bool wroteBatch = false;
+        if (!m_queue.empty()) {
+            std::vector<ClipboardEntry> batch;
+            batch.swap(m_queue);
+            bool syncAfter = m_syncPolicy == SyncPolicy::PerBatch;
+            m_writing = true;
+
+            lock.unlock();
+            WriteBatch(batch, syncAfter);
+            lock.lock();
+
+            m_writing = false;
+            m_drainedCv.notify_all();
+            lastWrite = std::chrono::steady_clock::now();
+            wroteSinceCompaction = true;
+            wroteBatch = true;
         }
-        pos = 0;
-        while ((pos = text.find(L"\\p", pos)) != std::wstring::npos) {
-            text.replace(pos, 2, L"|");
-            pos += 1;
+
+        if (m_syncPolicy == SyncPolicy::Interval && m_unsynced &&
+            std::chrono::steady_clock::now() - lastSync >= m_syncInterval) {
+            lock.unlock();
+            SyncFile();
+            lock.lock();
+            lastSync = std::chrono::steady_clock::now();
         }
 
-        entry.text = text;
+        // Compact when asked to, once capture has gone quiet, or when storage
+        // has outgrown the entries it retains. New entries keep queueing
+        // meanwhile and are written once compaction is done.
+        bool idle = wroteSinceCompaction &&
+            std::chrono::steady_clock::now() - lastWrite >= m_compactIdle;
+        if (!m_stopping && (m_compactRequested || idle || wroteBatch)) {
+            // Only an explicit request rewrites regardless of size
+            bool settle = m_compactRequested || idle;
+            size_t retain = m_retainEntries;
+            double ratio = m_compactRatio;
+            if (m_compactRequested) {
+                ratio = 0.0;
+            } else if (idle) {
+                ratio = std::min(ratio, kIdleCompactRatio);
+            }
+            m_compactRequested = false;
+
+            lock.unlock();
+            CompactLog(retain, ratio);
+            lock.lock();
 
-        // Convert timestamp string to time_point
-        try {
-            std::time_t epoch = std::stoll(timestampStr);
-            entry.timestamp = std::chrono::system_clock::from_time_t(epoch);
-        } catch (...) {
-            entry.timestamp = std::chrono::system_clock::now();
+            if (settle) {
+                wroteSinceCompaction = false;
+            }
+        }
+
+        if (m_stopping && m_queue.empty()) {
+            break;
         }
+    }
+}
+
 
-        entries.push_back(entry);
+void Storage::WriteBatch(const std::vector<ClipboardEntry>& batch, bool syncAfter) {
+    bool ok;
+    {
+        std::lock_guard<std::mutex> change(m_changeMutex);
+        m_version++;
+        ok = m_engine->Append(batch, syncAfter);
+        m_version++;
     }
+    if (!ok) {
+        std::wcerr << L"Failed to write " << batch.size() << L" entries to storage" << std::endl;
+    }
+    m_unsynced = !(syncAfter && ok);
+}
 
-    file.close();
+void Storage::SyncFile() {
+    if (m_engine->Sync()) {
+        m_unsynced = false;
+    }
+}
 
-    // Reverse to get newest first (file has oldest first)
-    std::reverse(entries.begin(), entries.end());
+std::vector<ClipboardEntry> Storage::LoadEntries(size_t limit) {
+    Flush();
+    return m_engine->LoadLatest(limit);
+}
 
-    return entries;
+void Storage::ForEachEntry(const std::function<bool(const ClipboardEntry&)>& visit) {
+    Flush();
+    m_engine->ForEach(visit);
 }
 
 bool Storage::ClearAll() {
-    std::wofstream file(m_dbPath, std::ios::trunc);
-    if (!file) {
+    Flush();
+    bool cleared;
+    {
+        std::lock_guard<std::mutex> change(m_changeMutex);
+        m_version++;
+        cleared = m_engine->Clear();
+        m_epoch++;
+        m_version++;
+    }
+    if (!cleared) {
         return false;
     }
-    file.close();
+    m_unsynced = true;
     std::wcout << L"Storage cleared" << std::endl;
     return true;
 }
 
 size_t Storage::GetCount() {
-    std::wifstream file(m_dbPath);
-    if (!file) {
-        return 0;
-    }
+    return static_cast<size_t>(m_engine->GetStats().entryCount);
+}
 
-    size_t count = 0;
-    std::wstring line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            count++;
-        }
+StorageStats Storage::GetStats() {
+    return m_engine->GetStats();
+}
+
+void Storage::SetCompactionPolicy(size_t retainEntries, double sizeRatio, unsigned idleSeconds) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_retainEntries = retainEntries;
+    m_compactRatio = sizeRatio;
+    m_compactIdle = std::chrono::seconds(idleSeconds);
+    m_queueCv.notify_one();
+}
+
+void Storage::SetRetentionPolicy(unsigned maxAgeDays, uint64_t maxBytes) {
+    m_engine->SetRetention(std::chrono::hours(24 * maxAgeDays), maxBytes);
+
+    // Applied on the writer thread along with compaction
+    RequestCompaction();
+}
+
+void Storage::RequestCompaction() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_compactRequested = true;
+    m_queueCv.notify_one();
+}
+
+bool Storage::CompactLog(size_t retainEntries, double minSizeRatio) {
+    std::lock_guard<std::mutex> change(m_changeMutex);
+    m_version++;
+    bool compacted = m_engine->Compact(retainEntries, minSizeRatio);
+
+    // Engines report false when they left their entries as they were, so a
+    // skipped compaction must not invalidate what readers have cached
+    if (compacted) {
+        m_epoch++;
+        m_version++;
+    } else {
+        m_version--;
     }
+    return compacted;
+}
 
-    file.close();
-    return count;
+bool Storage::ReadEntryAt(size_t position, ClipboardEntry& entry) {
+    return m_engine->ReadAt(position, entry);
 }
 
-bool Storage::CreateTables() {
-    // Not needed for file-based storage
-    return true;
+bool Storage::FindEntryByTime(std::chrono::system_clock::time_point time, size_t& position) {
+    return m_engine->FindByTime(time, position);
+}
+
+uint64_t Storage::GetVersion() const {
+    return m_version;
+}
+
+uint64_t Storage::GetEpoch() const {
+    return m_epoch;
 }
@@ -0,0 +1,125 @@
+#include "TextArena.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+// Emptied chunks kept for reuse; past this they are freed
+const size_t kMaxSpareChunks = 4;
+
+} // namespace
+
+TextArena::TextArena(size_t chunkBytes)
+    : m_chunkBytes(chunkBytes)
+    , m_current(0)
+    , m_hasCurrent(false)
+    , m_liveBytes(0)
+    , m_usedBytes(0)
+{
+}
+
+TextArena::Ref TextArena::Store(std::string_view text) {
+    if (!m_hasCurrent || m_chunks[m_current]->capacity - m_chunks[m_current]->used < text.size()) {
+        StartChunk(text.size());
+    }
+
+    Chunk& chunk = *m_chunks[m_current];
+    Ref ref;
+    ref.chunk = m_current;
+    ref.offset = static_cast<uint32_t>(chunk.used);
+    ref.length = static_cast<uint32_t>(text.size());
+    if (!text.empty()) {
+        std::memcpy(chunk.data.get() + chunk.used, text.data(), text.size());
+    }
+    chunk.used += text.size();
+    chunk.live += text.size();
+    m_usedBytes += text.size();
+    m_liveBytes += text.size();
+    return ref;
+}
+
+std::string_view TextArena::View(const Ref& ref) const {
+    return std::string_view(m_chunks[ref.chunk]->data.get() + ref.offset, ref.length);
+}
+
+void TextArena::Release(const Ref& ref) {
+    Chunk& chunk = *m_chunks[ref.chunk];
+    chunk.live -= ref.length;
+    m_liveBytes -= ref.length;
+    if (chunk.live == 0 && !(m_hasCurrent && ref.chunk == m_current)) {
+        Retire(ref.chunk);
+    }
+}
+
+void TextArena::Clear() {
+    for (uint32_t id = 0; id < m_chunks.size(); id++) {
+        if (m_chunks[id]) {
+            Retire(id);
+        }
+    }
+    m_hasCurrent = false;
+    m_liveBytes = 0;
+    m_usedBytes = 0;
+}
+
+std::vector<std::shared_ptr<const TextArena::Chunk>> TextArena::Pin() const {
+    std::vector<std::shared_ptr<const Chunk>> pinned;
+    for (const auto& chunk : m_chunks) {
+        if (chunk) {
+            pinned.push_back(chunk);
+        }
+    }
+    return pinned;
+}
+
+void TextArena::StartChunk(size_t minBytes) {
+    // The chunk being left behind goes now if it is already empty
+    if (m_hasCurrent && m_chunks[m_current]->live == 0) {
+        Retire(m_current);
+    }
+
+    std::shared_ptr<Chunk> chunk;
+    if (minBytes <= m_chunkBytes && !m_spare.empty()) {
+        chunk = std::move(m_spare.back());
+        m_spare.pop_back();
+    } else {
+        // Oversized text gets a chunk of its own
+        chunk = std::make_shared<Chunk>();
+        chunk->capacity = std::max(minBytes, m_chunkBytes);
+        chunk->data.reset(new char[chunk->capacity]);
+    }
+
+    uint32_t id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_chunks[id] = std::move(chunk);
+    } else {
+        id = static_cast<uint32_t>(m_chunks.size());
+        m_chunks.push_back(std::move(chunk));
+    }
+    m_current = id;
+    m_hasCurrent = true;
+}
+
+void TextArena::Retire(uint32_t id) {
+    std::shared_ptr<Chunk>& chunk = m_chunks[id];
+    m_usedBytes -= chunk->used;
+    m_liveBytes -= chunk->live;
+
+    // Reuse it only if no reader still has it pinned. Pins are only taken
+    // by the owner, so a count of one cannot be racing a new pin; the fence
+    // orders the last reader's accesses before the chunk is written again.
+    if (chunk.use_count() == 1 && chunk->capacity == m_chunkBytes && m_spare.size() < kMaxSpareChunks) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        chunk->used = 0;
+        chunk->live = 0;
+        m_spare.push_back(std::move(chunk));
+    }
+    chunk.reset();
+    m_freeIds.push_back(id);
+    if (m_hasCurrent && id == m_current) {
+        m_hasCurrent = false;
+    }
+}
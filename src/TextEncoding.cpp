@@ -0,0 +1,161 @@
+#include "TextEncoding.h"
+#include <cwchar>
+#include <cwctype>
+
+namespace {
+
+const char32_t kReplacementChar = 0xFFFD;
+
+void AppendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+void AppendWide(std::wstring& out, char32_t cp) {
+    if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+        cp -= 0x10000;
+        out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+        out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+    } else {
+        out.push_back(static_cast<wchar_t>(cp));
+    }
+}
+
+// Decode the multi-byte sequence at p[0]. Returns its length, or 0 if it is
+// not valid UTF-8.
+size_t DecodeUtf8(const unsigned char* p, size_t size, char32_t& cp) {
+    unsigned char lead = p[0];
+    size_t length = 0;
+    char32_t minValue = 0;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2; cp = lead & 0x1F; minValue = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3; cp = lead & 0x0F; minValue = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4; cp = lead & 0x07; minValue = 0x10000;
+    }
+
+    if (length == 0 || length > size) {
+        return 0;
+    }
+    for (size_t k = 1; k < length; k++) {
+        if ((p[k] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+
+    if (cp < minValue || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+} // namespace
+
+std::string TextEncoding::WideToUtf8(const std::wstring& text) {
+    return WideToUtf8(text.data(), text.size());
+}
+
+std::string TextEncoding::WideToUtf8(const wchar_t* data, size_t size) {
+    std::string out;
+    out.reserve(size);
+
+    for (size_t i = 0; i < size; i++) {
+        char32_t cp = static_cast<char32_t>(data[i]);
+
+        // Combine UTF-16 surrogate pairs
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < size) {
+            char32_t low = static_cast<char32_t>(data[i + 1]);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+            cp = kReplacementChar;
+        }
+        AppendUtf8(out, cp);
+    }
+
+    return out;
+}
+
+std::wstring TextEncoding::Utf8ToWide(const char* data, size_t size) {
+    std::wstring out;
+    out.reserve(size);
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < size) {
+        // Fast path for ASCII
+        if (p[i] < 0x80) {
+            out.push_back(static_cast<wchar_t>(p[i]));
+            i++;
+            continue;
+        }
+
+        char32_t cp = 0;
+        size_t length = DecodeUtf8(p + i, size - i, cp);
+        if (length == 0) {
+            AppendWide(out, kReplacementChar);
+            i++;
+            continue;
+        }
+
+        AppendWide(out, cp);
+        i += length;
+    }
+
+    return out;
+}
+
+std::wstring TextEncoding::Utf8ToWide(const std::string& text) {
+    return Utf8ToWide(text.data(), text.size());
+}
+
+void TextEncoding::LowerCase(std::string_view text, std::string& out) {
+    out.clear();
+    out.reserve(text.size());
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    size_t i = 0;
+    while (i < text.size()) {
+        if (p[i] < 0x80) {
+            unsigned char c = p[i];
+            out.push_back(static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c));
+            i++;
+            continue;
+        }
+
+        char32_t cp = 0;
+        size_t length = DecodeUtf8(p + i, text.size() - i, cp);
+        if (length == 0) {
+            out.push_back(static_cast<char>(p[i]));
+            i++;
+            continue;
+        }
+
+        // wchar_t cannot hold a supplementary character on Windows; those
+        // have no case mapping in towlower anyway
+        if (cp <= static_cast<char32_t>(WCHAR_MAX)) {
+            cp = static_cast<char32_t>(towlower(static_cast<wint_t>(cp)));
+        }
+        AppendUtf8(out, cp);
+        i += length;
+    }
+}
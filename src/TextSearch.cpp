@@ -0,0 +1,291 @@
+#include "TextSearch.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CLIPPY2000_SEARCH_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+// A needle of two or more bytes, with the two positions the filters test
+// candidates on: the rarest byte and the next rarest
+struct Needle {
+    const char* data;
+    size_t length;
+    size_t rare1;
+    size_t rare2;
+};
+
+using FindFunction = size_t (*)(const char* text, size_t size, const Needle& needle);
+
+// Below this many bytes of text, a one-off Find costs about as much as
+// ranking the needle's bytes, so it does without
+const size_t kShortText = 1024;
+
+// Bytes of clipboard text from most to least common, roughly: English
+// letters by frequency, then the digits, punctuation and capitals of code,
+// paths and URLs. Bytes of UTF-8 sequences come next; control characters
+// and anything else not listed are the rarest.
+const char kCommonBytes[] = " etaoinsrhldcumfpgwyb.,\n/v0-1k:\\_2=\"()3'TSAECIRNOPMLD";
+const char kUncommonBytes[] = "\t\r;4596x87><[]{}BFGHUWVYjKq!?zJ&%#@|*+$XQZ~^`";
+
+struct ByteRanks {
+    uint8_t rank[256] = {}; // Higher is more common
+    uint8_t rare = 0;       // Ranks below this are kUncommonBytes and the unlisted
+
+    constexpr ByteRanks() {
+        int next = 255;
+        for (size_t i = 0; i + 1 < sizeof(kCommonBytes); i++) {
+            rank[static_cast<unsigned char>(kCommonBytes[i])] = static_cast<uint8_t>(next--);
+        }
+        for (int byte = 0x80; byte < 0x100; byte++) {
+            rank[byte] = static_cast<uint8_t>(next);
+        }
+        rare = static_cast<uint8_t>(next--);
+        for (size_t i = 0; i + 1 < sizeof(kUncommonBytes); i++) {
+            rank[static_cast<unsigned char>(kUncommonBytes[i])] = static_cast<uint8_t>(next--);
+        }
+    }
+};
+
+constexpr ByteRanks kRanks;
+
+uint8_t Rank(char byte) {
+    return kRanks.rank[static_cast<unsigned char>(byte)];
+}
+
+// The needle's rarest byte and the next rarest. Most bytes are no rarer
+// than the two kept so far, so the branches are well predicted.
+Needle PlanNeedle(std::string_view needle) {
+    Needle plan = { needle.data(), needle.size(), 0, 1 };
+    uint8_t rank1 = Rank(needle[0]);
+    uint8_t rank2 = Rank(needle[1]);
+    if (rank2 < rank1) {
+        std::swap(plan.rare1, plan.rare2);
+        std::swap(rank1, rank2);
+    }
+    for (size_t i = 2; i < needle.size(); i++) {
+        uint8_t rank = Rank(needle[i]);
+        if (rank >= rank2) {
+            continue;
+        }
+        if (rank < rank1) {
+            plan.rare2 = plan.rare1;
+            rank2 = rank1;
+            plan.rare1 = i;
+            rank1 = rank;
+        } else {
+            plan.rare2 = i;
+            rank2 = rank;
+        }
+    }
+    return plan;
+}
+
+size_t FindScalar(const char* text, size_t size, const Needle& needle) {
+    return std::string_view(text, size).find(std::string_view(needle.data, needle.length));
+}
+
+// memchr for the needle's rarest byte, checking each hit. Where that byte
+// really is rare this skips through text faster than the vector filters,
+// which test two bytes at every position; once hits come closer together
+// than kMinHitSpacing bytes on average the rest is handed to find.
+const size_t kMinHits = 8;
+const size_t kMinHitSpacing = 64;
+
+size_t FindRare(const char* text, size_t size, const Needle& needle, FindFunction find) {
+    const char rare = needle.data[needle.rare1];
+    size_t last = size - needle.length; // Last possible match position
+    size_t hits = 0;
+    for (size_t i = 0; i <= last;) {
+        const void* hit = std::memchr(text + i + needle.rare1, rare, last - i + 1);
+        if (!hit) {
+            return std::string_view::npos;
+        }
+        size_t position = static_cast<size_t>(static_cast<const char*>(hit) - text) - needle.rare1;
+        if (std::memcmp(text + position, needle.data, needle.length) == 0) {
+            return position;
+        }
+        i = position + 1;
+        if (++hits >= kMinHits && i < hits * kMinHitSpacing) {
+            size_t rest = find(text + i, size - i, needle);
+            return rest == std::string_view::npos ? rest : i + rest;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#if defined(CLIPPY2000_SEARCH_SIMD)
+
+int LowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Each candidate position is tested by comparing the block that far past
+// it with the needle's rarest byte and the block as far past it with its
+// next rarest; only positions where both match get a full comparison.
+// Needles are at least two bytes, and the scalar search finishes the tail.
+size_t FindSse2(const char* text, size_t size, const Needle& needle) {
+    const __m128i rare1 = _mm_set1_epi8(needle.data[needle.rare1]);
+    const __m128i rare2 = _mm_set1_epi8(needle.data[needle.rare2]);
+    size_t i = 0;
+    for (; i + needle.length - 1 + 16 <= size; i += 16) {
+        __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + needle.rare1));
+        __m128i block2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + needle.rare2));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block1, rare1), _mm_cmpeq_epi8(block2, rare2))));
+        while (mask != 0) {
+            size_t position = i + LowestBit(mask);
+            if (std::memcmp(text + position, needle.data, needle.length) == 0) {
+                return position;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = FindScalar(text + i, size - i, needle);
+    return rest == std::string_view::npos ? rest : i + rest;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+size_t FindAvx2(const char* text, size_t size, const Needle& needle) {
+    const __m256i rare1 = _mm256_set1_epi8(needle.data[needle.rare1]);
+    const __m256i rare2 = _mm256_set1_epi8(needle.data[needle.rare2]);
+    size_t i = 0;
+    for (; i + needle.length - 1 + 32 <= size; i += 32) {
+        __m256i block1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + needle.rare1));
+        __m256i block2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + needle.rare2));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block1, rare1), _mm256_cmpeq_epi8(block2, rare2))));
+        while (mask != 0) {
+            size_t position = i + LowestBit(mask);
+            if (std::memcmp(text + position, needle.data, needle.length) == 0) {
+                return position;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = FindSse2(text + i, size - i, needle);
+    return rest == std::string_view::npos ? rest : i + rest;
+}
+
+bool HasAvx2() {
+#ifdef _MSC_VER
+    // AVX2 needs the CPU flag and the OS saving the YMM registers
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+FindFunction SelectFind() {
+    return HasAvx2() ? FindAvx2 : FindSse2;
+}
+
+#else
+
+FindFunction SelectFind() {
+    return FindScalar;
+}
+
+#endif
+
+FindFunction MethodFunction(TextSearch::Method method) {
+    switch (method) {
+#if defined(CLIPPY2000_SEARCH_SIMD)
+    case TextSearch::Method::Sse2:
+        return FindSse2;
+    case TextSearch::Method::Avx2:
+        return FindAvx2;
+#endif
+    default:
+        return FindScalar;
+    }
+}
+
+FindFunction SelectedFind() {
+    static const FindFunction find = SelectFind();
+    return find;
+}
+
+// A needle made only of common bytes goes straight to the filters
+size_t FindPlanned(const char* text, size_t size, const Needle& needle) {
+    if (Rank(needle.data[needle.rare1]) >= kRanks.rare) {
+        return SelectedFind()(text, size, needle);
+    }
+    return FindRare(text, size, needle, SelectedFind());
+}
+
+} // namespace
+
+size_t TextSearch::Find(std::string_view text, std::string_view needle) {
+    if (needle.size() < 2 || needle.size() > text.size()) {
+        return text.find(needle);
+    }
+
+    // Short text: filter on the needle's first and last bytes, or go from
+    // one occurrence of its first byte to the next if that is rare
+    if (text.size() < kShortText) {
+        if (Rank(needle[0]) < kRanks.rare) {
+            return text.find(needle);
+        }
+        return SelectedFind()(text.data(), text.size(), { needle.data(), needle.size(), 0, needle.size() - 1 });
+    }
+    return FindPlanned(text.data(), text.size(), PlanNeedle(needle));
+}
+
+TextSearch::Pattern::Pattern(std::string_view needle)
+    : m_needle(needle)
+    , m_rare1(0)
+    , m_rare2(1)
+{
+    if (needle.size() >= 2) {
+        Needle plan = PlanNeedle(needle);
+        m_rare1 = plan.rare1;
+        m_rare2 = plan.rare2;
+    }
+}
+
+size_t TextSearch::Pattern::Find(std::string_view text) const {
+    if (m_needle.size() < 2 || m_needle.size() > text.size()) {
+        return text.find(m_needle);
+    }
+    return FindPlanned(text.data(), text.size(), { m_needle.data(), m_needle.size(), m_rare1, m_rare2 });
+}
+
+bool TextSearch::IsSupported(Method method) {
+#if defined(CLIPPY2000_SEARCH_SIMD)
+    // SSE2 is part of x86-64
+    return method != Method::Avx2 || HasAvx2();
+#else
+    return method == Method::Scalar;
+#endif
+}
+
+size_t TextSearch::FindWith(Method method, std::string_view text, std::string_view needle) {
+    if (needle.size() < 2 || needle.size() > text.size()) {
+        return text.find(needle);
+    }
+    return MethodFunction(method)(text.data(), text.size(), PlanNeedle(needle));
+}
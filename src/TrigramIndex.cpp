@@ -0,0 +1,147 @@
+#include "TrigramIndex.h"
+#include <algorithm>
+
+namespace {
+
+// A list this many times longer than the candidates so far costs more to
+// decode than checking the candidates does
+const size_t kMaxListRatio = 32;
+
+void AppendVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ReadVarint(const uint8_t*& p) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= static_cast<uint64_t>(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint64_t>(*p++) << shift;
+    return value;
+}
+
+} // namespace
+
+void TrigramIndex::Trigrams(std::string_view text, std::vector<uint32_t>& keys) {
+    keys.clear();
+    if (text.size() < 3) {
+        return;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    uint32_t key = (static_cast<uint32_t>(p[0]) << 8) | p[1];
+    for (size_t i = 2; i < text.size(); i++) {
+        key = ((key << 8) | p[i]) & 0xFFFFFF;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+void TrigramIndex::Add(uint64_t id, const std::vector<uint32_t>& keys) {
+    for (uint32_t key : keys) {
+        Postings& postings = m_postings[key];
+        size_t before = postings.gaps.capacity();
+        AppendVarint(postings.gaps, id - postings.last);
+        m_bytes += postings.gaps.capacity() - before;
+        postings.last = id;
+        postings.count++;
+    }
+}
+
+void TrigramIndex::Find(const std::vector<uint32_t>& keys, std::vector<uint64_t>& ids) const {
+    ids.clear();
+    std::vector<const Postings*> lists;
+    lists.reserve(keys.size());
+    for (uint32_t key : keys) {
+        auto it = m_postings.find(key);
+        if (it == m_postings.end() || it->second.count == 0) {
+            return;
+        }
+        lists.push_back(&it->second);
+    }
+    if (lists.empty()) {
+        return;
+    }
+
+    // Start from the shortest list and narrow it with the others
+    std::sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->count < b->count; });
+
+    const uint8_t* p = lists[0]->gaps.data();
+    uint64_t id = 0;
+    ids.reserve(lists[0]->count);
+    for (size_t i = 0; i < lists[0]->count; i++) {
+        id += ReadVarint(p);
+        ids.push_back(id);
+    }
+
+    for (size_t l = 1; l < lists.size() && !ids.empty(); l++) {
+        const Postings& postings = *lists[l];
+        if (postings.count > ids.size() * kMaxListRatio) {
+            break; // Lists are sorted by length, so the rest are longer
+        }
+        p = postings.gaps.data();
+        id = 0;
+        size_t read = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < ids.size(); i++) {
+            while (read < postings.count && (read == 0 || id < ids[i])) {
+                id += ReadVarint(p);
+                read++;
+            }
+            if (read > 0 && id == ids[i]) {
+                ids[kept++] = ids[i];
+            } else if (id < ids[i]) {
+                break; // List ran out
+            }
+        }
+        ids.resize(kept);
+    }
+}
+
+size_t TrigramIndex::ShortestList(const std::vector<uint32_t>& keys) const {
+    size_t shortest = SIZE_MAX;
+    for (uint32_t key : keys) {
+        auto it = m_postings.find(key);
+        if (it == m_postings.end()) {
+            return 0;
+        }
+        shortest = std::min(shortest, it->second.count);
+    }
+    return keys.empty() ? 0 : shortest;
+}
+
+void TrigramIndex::Clear() {
+    for (auto& entry : m_postings) {
+        entry.second.gaps.clear();
+        entry.second.last = 0;
+        entry.second.count = 0;
+    }
+}
+
+void TrigramIndex::DropEmpty() {
+    // Trigrams come and go as the history turns over; keeping their lists
+    // means indexing them again allocates nothing, as long as they do not
+    // pile up
+    size_t empty = 0;
+    for (const auto& entry : m_postings) {
+        empty += entry.second.count == 0 ? 1 : 0;
+    }
+    if (empty * 2 <= m_postings.size()) {
+        return;
+    }
+
+    for (auto it = m_postings.begin(); it != m_postings.end();) {
+        if (it->second.count == 0) {
+            m_bytes -= it->second.gaps.capacity();
+            it = m_postings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -2,17 +2,23 @@
 #include <shellapi.h>
 #include "ClipboardMonitor.h"
 #include "ClipboardHistory.h"
+#include "IngestPipeline.h"
+#include "ColdSearch.h"
 #include "HotkeyManager.h"
 #include "Storage.h"
+#include "BlobStore.h"
 #include "ClipboardUtils.h"
 #include "HistoryWindow.h"
 #include "SystemTray.h"
 
 #define WM_TRAYICON (WM_USER + 1)
+#define WM_HISTORYCHANGED (WM_USER + 2)
+#define WM_COLDSEARCHDONE (WM_USER + 3)
 
 // Global pointers for access in window procedure
 ClipboardMonitor* g_monitor = nullptr;
 ClipboardHistory* g_history = nullptr;
+IngestPipeline* g_ingest = nullptr;
 HotkeyManager* g_hotkeyMgr = nullptr;
 Storage* g_storage = nullptr;
 HistoryWindow* g_historyWindow = nullptr;
@@ -34,6 +40,18 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
                 g_hotkeyMgr->OnHotkey(static_cast<int>(wParam));
             }
             return 0;
+        case WM_HISTORYCHANGED:
+            // Posted by the ingest consumer once per batch it added
+            if (g_historyWindow && g_history) {
+                g_historyWindow->RefreshIfVisible(g_history->GetSnapshot());
+            }
+            return 0;
+        case WM_COLDSEARCHDONE:
+            // Posted by the cold search worker when a search finished
+            if (g_historyWindow) {
+                g_historyWindow->OnColdSearchDone();
+            }
+            return 0;
         case WM_TRAYICON:
             if (g_systemTray) {
                 g_systemTray->OnTrayMessage(wParam, lParam);
@@ -80,24 +98,56 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     // Initialize storage
-    Storage storage(L"clippy2000.db");
+#ifdef CLIPPY2000_HAVE_SQLITE
+    Storage storage(L"clippy2000.db", StorageBackend::Sqlite);
+#else
+    // Segments let retention drop old history without rewriting the log;
+    // an existing single-file log becomes the first segment
+    Storage storage(L"clippy2000.db", StorageBackend::Segmented);
+#endif
     g_storage = &storage;
 
+    // Memory holds the newest entries; far more stay on disk, where the
+    // history pages them in on demand. Nothing older than 90 days or past
+    // 1 GB on disk is kept.
+    storage.SetCompactionPolicy(100000);
+    storage.SetRetentionPolicy(90, 1024ull * 1024 * 1024);
+
     if (!storage.Initialize()) {
         MessageBox(NULL, L"Failed to initialize storage", L"Error", MB_OK | MB_ICONERROR);
         return 1;
     }
 
-    // Initialize clipboard history
+    // Bodies of large history entries live on disk; only a preview is
+    // kept in memory. The history rebuilds it from storage on every start.
+    BlobStore spillStore;
+    bool haveSpillStore = spillStore.Open(L"clippy2000.spill");
+
+    // Initialize clipboard history, capped at 64 MB of resident text
     ClipboardHistory history(100);
     g_history = &history;
+    history.SetMaxBytes(64 * 1024 * 1024);
+    if (haveSpillStore) {
+        history.SetSpillStore(&spillStore, 1024 * 1024);
+    }
+    history.SetColdStorage(&storage);
 
-    // Load persisted entries
+    // Load persisted entries (newest first), replaying oldest first so the
+    // newest ends up at the front of the history
     auto savedEntries = storage.LoadEntries(100);
-    for (const auto& entry : savedEntries) {
-        history.AddEntry(entry.text, entry.type);
+    for (auto it = savedEntries.rbegin(); it != savedEntries.rend(); ++it) {
+        history.AddEntry(std::move(*it));
     }
 
+    // History inserts and storage writes happen on the ingest consumer
+    // thread, so capture never waits on them
+    IngestPipeline ingest(history, storage);
+    g_ingest = &ingest;
+    ingest.SetBatchCallback([hwnd]() {
+        PostMessage(hwnd, WM_HISTORYCHANGED, 0, 0);
+    });
+    ingest.Start();
+
     // Initialize clipboard monitor
     ClipboardMonitor monitor;
     g_monitor = &monitor;
@@ -107,7 +157,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 1;
     }
 
-    // Set callback to add to history, save to storage, and print
+    // Set callback to hand each capture to the ingest pipeline
     monitor.SetCallback([]() {
         // Check if we should ignore this change (we caused it ourselves)
         if (g_ignoreNextClipboardChange) {
@@ -116,40 +166,25 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         }
 
         ClipboardDataType dataType = ClipboardUtils::GetClipboardDataType();
-        std::wstring data;
-        ClipboardEntry entry;
+        std::string data;
 
         switch (dataType) {
             case ClipboardDataType::Text:
                 data = ClipboardUtils::GetClipboardText();
-                if (!data.empty()) {
-                    entry = ClipboardEntry(data, ClipboardDataType::Text);
-                    g_history->AddEntry(data, ClipboardDataType::Text);
-                    g_storage->SaveEntry(entry);
-                }
                 break;
 
             case ClipboardDataType::Files:
                 data = ClipboardUtils::GetClipboardFiles();
-                if (!data.empty()) {
-                    entry = ClipboardEntry(data, ClipboardDataType::Files);
-                    g_history->AddEntry(data, ClipboardDataType::Files);
-                    g_storage->SaveEntry(entry);
-                }
                 break;
 
             case ClipboardDataType::Image:
-                data = L"[Image]";
-                entry = ClipboardEntry(data, ClipboardDataType::Image);
-                g_history->AddEntry(data, ClipboardDataType::Image);
-                g_storage->SaveEntry(entry);
+                data = "[Image]";
                 break;
         }
 
-        // Update GUI if visible
-        if (!data.empty() && g_historyWindow) {
-            auto entries = g_history->GetEntries();
-            g_historyWindow->RefreshIfVisible(entries);
+        // The GUI is refreshed when the consumer posts WM_HISTORYCHANGED
+        if (!data.empty()) {
+            g_ingest->Submit(ClipboardEntry(data, dataType));
         }
     });
 
@@ -184,12 +219,22 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         }
     });
 
+    // Searches that match few recent entries continue into older ones on a
+    // worker thread, bounded so a keystroke never scans the whole history.
+    // A newer keystroke stops the search still running.
+    ColdSearch coldSearch(history, 5000);
+    coldSearch.SetDoneCallback([hwnd]() {
+        PostMessage(hwnd, WM_COLDSEARCHDONE, 0, 0);
+    });
+    coldSearch.Start();
+    historyWindow.SetColdSearch(&coldSearch);
+
     // Register Ctrl+Shift+V to toggle GUI history window
     hotkeyMgr.RegisterHotkey(MOD_CONTROL | MOD_SHIFT, 'V', []() {
         if (g_historyWindow->IsVisible()) {
             g_historyWindow->Hide();
         } else {
-            auto entries = g_history->GetEntries();
+            auto entries = g_history->GetSnapshot();
             g_historyWindow->UpdateHistory(entries);
             g_historyWindow->Show();
         }
@@ -211,16 +256,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 if (g_historyWindow->IsVisible()) {
                     g_historyWindow->Hide();
                 } else {
-                    auto entries = g_history->GetEntries();
+                    auto entries = g_history->GetSnapshot();
                     g_historyWindow->UpdateHistory(entries);
                     g_historyWindow->Show();
                 }
                 break;
             case 1002: // ID_CLEAR_HISTORY
+                // Let captures already queued land first, so they are cleared too
+                g_ingest->Flush();
                 g_history->Clear();
                 g_storage->ClearAll();
                 if (g_historyWindow->IsVisible()) {
-                    g_historyWindow->UpdateHistory({});
+                    g_historyWindow->UpdateHistory(HistorySnapshot());
                 }
                 break;
             case 1003: // ID_EXIT
@@ -232,7 +279,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     systemTray.Show();
 
     // Show the history window on startup
-    auto entries = history.GetEntries();
+    auto entries = history.GetSnapshot();
     historyWindow.UpdateHistory(entries);
     historyWindow.Show();
 
@@ -243,8 +290,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         DispatchMessage(&msg);
     }
 
+    // Finish queued captures, then drain the storage writer
+    monitor.Stop();
+    coldSearch.Stop();
+    ingest.Stop();
+    storage.Shutdown();
+
     g_monitor = nullptr;
     g_history = nullptr;
+    g_ingest = nullptr;
     g_hotkeyMgr = nullptr;
     g_storage = nullptr;
     g_historyWindow = nullptr;
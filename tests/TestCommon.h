@@ -0,0 +1,37 @@
+#pragma once
+
+#include <iostream>
+
+// Minimal checks for the test programs: a failed CHECK reports where and
+// carries on, and main returns Test::Result() so CTest sees the outcome.
+// Output goes through std::wcout like the code under test, since a stream
+// used for both narrow and wide output drops one of them.
+namespace Test {
+
+inline int& Failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void Fail(const char* file, int line, const char* expression) {
+    std::wcout << file << L":" << line << L": CHECK failed: " << expression << std::endl;
+    Failures()++;
+}
+
+inline int Result() {
+    if (Failures() > 0) {
+        std::wcout << Failures() << L" check(s) failed" << std::endl;
+        return 1;
+    }
+    std::wcout << L"OK" << std::endl;
+    return 0;
+}
+
+} // namespace Test
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            Test::Fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (0)
@@ -0,0 +1,122 @@
+// LZ4 block codec: round trips across sizes and shapes, a hand-built block
+// from the format description, and malformed input that must be rejected
+// without reading or writing out of bounds.
+#include "TestCommon.h"
+#include "Compression.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint64_t Next(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+bool RoundTrips(const std::string& data) {
+    std::string compressed = Compression::Lz4Compress(data.data(), data.size());
+    std::string out;
+    return Compression::Lz4Decompress(compressed.data(), compressed.size(), data.size(), out) && out == data;
+}
+
+std::vector<std::string> Samples() {
+    uint64_t state = 1;
+    std::vector<std::string> samples = { "", "a", "abcd", "hello world", std::string(12, 'x'), std::string(13, 'x') };
+
+    // Runs, so matches overlap the bytes they produce
+    samples.push_back(std::string(100000, 'z'));
+    samples.push_back(std::string(1000, 'a') + "b" + std::string(1000, 'a'));
+
+    // Incompressible bytes, and text with repeats further apart than LZ4's
+    // 64 KiB window
+    std::string noise;
+    for (int i = 0; i < 70000; i++) {
+        noise.push_back(static_cast<char>(Next(state)));
+    }
+    samples.push_back(noise);
+    samples.push_back(noise.substr(0, 300) + noise + noise.substr(0, 300));
+
+    std::string text;
+    for (int i = 0; i < 5000; i++) {
+        text += "2024-05-01 12:00:" + std::to_string(i % 60) + " INFO request " + std::to_string(Next(state) % 1000) + " ok\n";
+    }
+    samples.push_back(text);
+
+    // Every length around the end-of-block rules
+    for (size_t length = 1; length < 40; length++) {
+        samples.push_back(text.substr(0, length));
+        samples.push_back(std::string(length, 'q'));
+    }
+    return samples;
+}
+
+void TestRoundTrip() {
+    for (const std::string& sample : Samples()) {
+        CHECK(RoundTrips(sample));
+    }
+
+    std::string compressible(200000, ' ');
+    for (size_t i = 0; i < compressible.size(); i++) {
+        compressible[i] = "clipboard history "[i % 18];
+    }
+    std::string compressed = Compression::Lz4Compress(compressible.data(), compressible.size());
+    CHECK(compressed.size() < compressible.size() / 20);
+}
+
+void TestKnownBlock() {
+    // Literals "abcd", a match 4 back of length 8, then five final literals
+    const unsigned char block[] = { 0x44, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x50, 'x', 'y', 'z', 'w', '1' };
+    std::string out;
+    CHECK(Compression::Lz4Decompress(reinterpret_cast<const char*>(block), sizeof(block), 17, out));
+    CHECK(out == "abcdabcdabcdxyzw1");
+}
+
+void TestCorruptInput() {
+    std::string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "entry " + std::to_string(i % 97) + " copied to the clipboard\n";
+    }
+    std::string compressed = Compression::Lz4Compress(text.data(), text.size());
+    std::string out;
+
+    // The wrong size is an error either way
+    CHECK(!Compression::Lz4Decompress(compressed.data(), compressed.size(), text.size() - 1, out));
+    CHECK(!Compression::Lz4Decompress(compressed.data(), compressed.size(), text.size() + 1, out));
+
+    // Every truncation runs out of input before producing rawSize bytes
+    for (size_t length = 0; length < compressed.size(); length++) {
+        CHECK(!Compression::Lz4Decompress(compressed.data(), length, text.size(), out));
+    }
+
+    // An offset of zero, or one reaching before the start of the output
+    const unsigned char zeroOffset[] = { 0x14, 'a', 0x00, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+    CHECK(!Compression::Lz4Decompress(reinterpret_cast<const char*>(zeroOffset), sizeof(zeroOffset), 14, out));
+    const unsigned char farOffset[] = { 0x14, 'a', 0x02, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+    CHECK(!Compression::Lz4Decompress(reinterpret_cast<const char*>(farOffset), sizeof(farOffset), 14, out));
+
+    // A length extension that runs off the end
+    const unsigned char openLength[] = { 0xF0, 0xFF, 0xFF };
+    CHECK(!Compression::Lz4Decompress(reinterpret_cast<const char*>(openLength), sizeof(openLength), 600, out));
+
+    // Flipped bytes may still decode, but never to the wrong size
+    uint64_t state = 7;
+    for (int i = 0; i < 5000; i++) {
+        std::string damaged = compressed;
+        for (int flips = 1 + static_cast<int>(Next(state) % 3); flips > 0; flips--) {
+            damaged[Next(state) % damaged.size()] ^= static_cast<char>(1 + Next(state) % 255);
+        }
+        if (Compression::Lz4Decompress(damaged.data(), damaged.size(), text.size(), out)) {
+            CHECK(out.size() == text.size());
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestKnownBlock();
+    TestCorruptInput();
+    return Test::Result();
+}
@@ -0,0 +1,103 @@
+// ClipboardHistory::AddEntry in steady state: once the ring, the indexes
+// and the text arena have grown to fit the history, adding an entry should
+// almost never go to the allocator. Counts calls to the global operator
+// new. What is left is a trigram list growing past the longest it has
+// been, which gets rarer the longer the history runs.
+#include "TestCommon.h"
+#include "ClipboardHistory.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_counting(false);
+std::atomic<size_t> g_allocations(0);
+
+void* Allocate(size_t size) {
+    if (g_counting.load(std::memory_order_relaxed)) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// Clipboard-like text drawn from a fixed vocabulary: some repeats (promoted
+// rather than added), some long pastes, and mixed case so the folded copy
+// is kept separately. With numbered is set each text also carries a running
+// number, so trigrams such as "250" keep becoming common for a while and
+// their index lists have to grow.
+std::vector<ClipboardEntry> MakeEntries(size_t count, uint64_t& state, bool numbered) {
+    static const char* const kWords[] = {
+        "Copy", "paste", "the", "Clipboard", "history", "search", "Window", "entry",
+        "text", "MEETING", "notes", "link", "path", "value", "error", "build"
+    };
+    std::vector<ClipboardEntry> entries;
+    entries.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t bits = state >> 16;
+        std::string text = numbered ? std::to_string(state % 1000000) : "";
+        for (int word = 0; word < 4 + static_cast<int>(bits % 5); word++) {
+            text += " ";
+            text += kWords[(bits >> (4 * word + 3)) % 16];
+        }
+        if (i % 10 == 0) {
+            text.append(2000, 'y');
+        }
+        entries.emplace_back(i % 7 == 0 ? std::string("repeated entry") : text);
+    }
+    return entries;
+}
+
+size_t CountAllocations(ClipboardHistory& history, std::vector<ClipboardEntry>& entries) {
+    g_allocations = 0;
+    g_counting = true;
+    for (ClipboardEntry& entry : entries) {
+        history.AddEntry(std::move(entry));
+    }
+    g_counting = false;
+    return g_allocations;
+}
+
+} // namespace
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+int main() {
+    const size_t kWarmUp = 200000;
+    const size_t kMeasured = 100000;
+
+    // Recurring vocabulary: once warmed up, a handful in 100k entries
+    ClipboardHistory history(1000);
+    uint64_t state = 1;
+    std::vector<ClipboardEntry> warmUp = MakeEntries(kWarmUp, state, false);
+    CountAllocations(history, warmUp);
+    std::vector<ClipboardEntry> measured = MakeEntries(kMeasured, state, false);
+    size_t allocations = CountAllocations(history, measured);
+    std::wcout << L"AddEntry: " << allocations << L" allocations over " << kMeasured << L" entries" << std::endl;
+    CHECK(allocations * 10000 <= kMeasured);
+    CHECK(history.GetCount() == 1000);
+
+    // Numbered text: only the lists of newly common trigrams grow
+    ClipboardHistory numbered(1000);
+    warmUp = MakeEntries(kWarmUp, state, true);
+    CountAllocations(numbered, warmUp);
+    measured = MakeEntries(kMeasured, state, true);
+    allocations = CountAllocations(numbered, measured);
+    std::wcout << L"AddEntry, numbered text: " << allocations << L" allocations over " << kMeasured << L" entries"
+               << std::endl;
+    CHECK(allocations * 100 < kMeasured);
+    return Test::Result();
+}
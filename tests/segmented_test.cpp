@@ -0,0 +1,250 @@
+// SegmentedEngine on disk: segments rotated by size and by day, the
+// manifest read back on reopen, retention by entry count, age and size, and
+// reads that open only the segments they need.
+#include "TestCommon.h"
+#include "SegmentedEngine.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int64_t kDayMs = 24 * 60 * 60 * 1000;
+
+// 2022-01-08, midnight UTC
+const int64_t kBaseMs = 19000 * kDayMs;
+
+std::filesystem::path Root() {
+    return std::filesystem::temp_directory_path() / "clippy2000_segmented_test";
+}
+
+// An empty directory for one test, and the log path inside it
+std::wstring FreshLog(const char* name) {
+    std::filesystem::path dir = Root() / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return (dir / "history.db").wstring();
+}
+
+bool SegmentExists(const std::wstring& path, const wchar_t* number) {
+    return std::filesystem::exists(std::filesystem::path(path + L"." + number));
+}
+
+std::chrono::system_clock::time_point Millis(int64_t ms) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(ms)));
+}
+
+int64_t NowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+ClipboardEntry Entry(const std::string& text, int64_t ms) {
+    ClipboardEntry entry(text);
+    entry.timestamp = Millis(ms);
+    return entry;
+}
+
+// count entries "entry <first>" onwards, one second apart from startMs, in
+// batches of batchSize
+void AppendEntries(SegmentedEngine& engine, int first, int count, int batchSize, int64_t startMs) {
+    for (int i = 0; i < count; i += batchSize) {
+        std::vector<ClipboardEntry> batch;
+        for (int j = i; j < i + batchSize && j < count; j++) {
+            batch.push_back(Entry("entry " + std::to_string(first + j), startMs + (first + j) * 1000));
+        }
+        CHECK(engine.Append(batch, false));
+    }
+}
+
+// The engine holds "entry <first>" to "entry <last>", newest at position 0
+void CheckRange(SegmentedEngine& engine, int first, int last) {
+    size_t count = static_cast<size_t>(last - first + 1);
+    CHECK(engine.GetStats().entryCount == count);
+    ClipboardEntry entry;
+    for (size_t i = 0; i < count; i++) {
+        CHECK(engine.ReadAt(i, entry) && entry.text == "entry " + std::to_string(last - static_cast<int>(i)));
+    }
+    CHECK(!engine.ReadAt(count, entry));
+
+    size_t visited = 0;
+    engine.ForEach([&](const ClipboardEntry& visitedEntry) {
+        CHECK(visitedEntry.text == "entry " + std::to_string(first + static_cast<int>(visited)));
+        visited++;
+        return true;
+    });
+    CHECK(visited == count);
+}
+
+// A new segment each UTC day, read back after a reopen through the manifest
+void TestDailyRotation() {
+    std::wstring path = FreshLog("daily");
+    {
+        SegmentedEngine engine(path, 0, true);
+        CHECK(engine.Open());
+        AppendEntries(engine, 0, 3, 3, kBaseMs + 60 * 60 * 1000);
+        AppendEntries(engine, 3, 3, 3, kBaseMs + kDayMs);
+        AppendEntries(engine, 6, 3, 3, kBaseMs + 2 * kDayMs);
+        CheckRange(engine, 0, 8);
+    }
+    CHECK(std::filesystem::exists(std::filesystem::path(path + L".manifest")));
+    CHECK(SegmentExists(path, L"000001") && SegmentExists(path, L"000002") && SegmentExists(path, L"000003"));
+    CHECK(!SegmentExists(path, L"000004"));
+
+    SegmentedEngine engine(path, 0, true);
+    CHECK(engine.Open());
+
+    // Only the segment being written is opened, the others are known from
+    // the manifest
+    CHECK(engine.GetOpenSegmentCount() == 1);
+    StorageStats stats = engine.GetStats();
+    CHECK(stats.entryCount == 9);
+    CHECK(stats.typeCounts[static_cast<size_t>(ClipboardDataType::Text)] == 9);
+    CHECK(engine.GetOpenSegmentCount() == 1);
+
+    // A time in the newest segment needs no other; one in the oldest opens
+    // that segment alone
+    size_t position = 0;
+    CHECK(engine.FindByTime(Millis(kBaseMs + 2 * kDayMs + 7500), position) && position == 1);
+    CHECK(engine.GetOpenSegmentCount() == 1);
+    CHECK(engine.FindByTime(Millis(kBaseMs + 60 * 60 * 1000 + 1000), position) && position == 7);
+    CHECK(engine.GetOpenSegmentCount() == 2);
+    CHECK(!engine.FindByTime(Millis(kBaseMs), position));
+
+    std::vector<ClipboardEntry> latest = engine.LoadLatest(4);
+    CHECK(latest.size() == 4 && latest[0].text == "entry 8" && latest[3].text == "entry 5");
+
+    // Appends on the same day continue the newest segment
+    AppendEntries(engine, 9, 1, 1, kBaseMs + 2 * kDayMs);
+    CHECK(!SegmentExists(path, L"000004"));
+    CheckRange(engine, 0, 9);
+}
+
+// Rotation by size, and retention by entry count cutting into the oldest
+// segment it keeps
+void TestSizeRotation() {
+    std::wstring path = FreshLog("size");
+    {
+        SegmentedEngine engine(path, 1024, false);
+        CHECK(engine.Open());
+        AppendEntries(engine, 0, 200, 10, kBaseMs);
+        CheckRange(engine, 0, 199);
+    }
+    CHECK(SegmentExists(path, L"000004"));
+
+    {
+        SegmentedEngine engine(path, 1024, false);
+        CHECK(engine.Open());
+        CheckRange(engine, 0, 199);
+
+        // Below the ratio nothing is dropped
+        CHECK(!engine.Compact(150, 2.0));
+        CHECK(engine.GetStats().entryCount == 200);
+
+        CHECK(engine.Compact(25, 0.0));
+        CHECK(!SegmentExists(path, L"000001"));
+        CheckRange(engine, 175, 199);
+        CHECK(!engine.Compact(25, 0.0));
+    }
+
+    SegmentedEngine engine(path, 1024, false);
+    CHECK(engine.Open());
+    CheckRange(engine, 175, 199);
+    AppendEntries(engine, 200, 5, 5, kBaseMs);
+    CheckRange(engine, 175, 204);
+}
+
+// Segments past the age limit are dropped and the one straddling it is trimmed
+void TestAgeRetention() {
+    int64_t now = NowMillis();
+    std::wstring path = FreshLog("age");
+    {
+        SegmentedEngine engine(path, 0, true);
+        CHECK(engine.Open());
+        CHECK(engine.Append({ Entry("entry 0", now - 10 * kDayMs) }, false));
+        CHECK(engine.Append({ Entry("entry 1", now - 5 * kDayMs) }, false));
+        CHECK(engine.Append({ Entry("entry 2", now - kDayMs) }, false));
+        CheckRange(engine, 0, 2);
+
+        engine.SetRetention(std::chrono::hours(24 * 3), 0);
+        CHECK(engine.Compact(1000, 0.0));
+        CheckRange(engine, 2, 2);
+        CHECK(!SegmentExists(path, L"000001") && !SegmentExists(path, L"000002"));
+    }
+
+    // The segment being written is never dropped, only cut back
+    path = FreshLog("age_active");
+    {
+        SegmentedEngine engine(path, 0, false);
+        CHECK(engine.Open());
+        CHECK(engine.Append({ Entry("entry 0", now - 10 * kDayMs), Entry("entry 1", now - 5 * kDayMs),
+                              Entry("entry 2", now - kDayMs), Entry("entry 3", now) }, false));
+        engine.SetRetention(std::chrono::hours(24 * 3), 0);
+        CHECK(engine.Compact(1000, 0.0));
+        CheckRange(engine, 2, 3);
+    }
+
+    // Retention set before Open applies on open
+    SegmentedEngine engine(path, 0, false);
+    engine.SetRetention(std::chrono::hours(12), 0);
+    CHECK(engine.Open());
+    CheckRange(engine, 3, 3);
+}
+
+// Whole segments are dropped, oldest first, until the rest fits the size limit
+void TestSizeRetention() {
+    std::wstring path = FreshLog("bytes");
+    SegmentedEngine engine(path, 1024, false);
+    CHECK(engine.Open());
+    AppendEntries(engine, 0, 200, 10, kBaseMs);
+
+    engine.SetRetention(std::chrono::hours(0), 4096);
+    CHECK(engine.Compact(1000, 0.0));
+    CHECK(!SegmentExists(path, L"000001"));
+
+    uint64_t kept = engine.GetStats().entryCount;
+    CHECK(kept > 0 && kept < 200);
+    CheckRange(engine, 200 - static_cast<int>(kept), 199);
+
+    uint64_t diskBytes = 0;
+    for (const auto& file : std::filesystem::directory_iterator(std::filesystem::path(path).parent_path())) {
+        std::wstring name = file.path().filename().wstring();
+        bool segmentFile = name.size() == 17 && name.compare(0, 11, L"history.db.") == 0 &&
+                           name.find_first_not_of(L"0123456789", 11) == std::wstring::npos;
+        if (segmentFile) {
+            diskBytes += file.file_size();
+        }
+    }
+    CHECK(diskBytes > 0 && diskBytes <= 4096);
+}
+
+// A log written before segments becomes the first one
+void TestAdoptLog() {
+    std::wstring path = FreshLog("adopt");
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(engine.Append({ Entry("entry 0", kBaseMs), Entry("entry 1", kBaseMs + 1000) }, true));
+    }
+
+    SegmentedEngine engine(path, 0, true);
+    CHECK(engine.Open());
+    CHECK(SegmentExists(path, L"000001"));
+    CHECK(!std::filesystem::exists(std::filesystem::path(path)));
+    CheckRange(engine, 0, 1);
+}
+
+} // namespace
+
+int main() {
+    TestDailyRotation();
+    TestSizeRotation();
+    TestAgeRetention();
+    TestSizeRetention();
+    TestAdoptLog();
+
+    std::error_code ec;
+    std::filesystem::remove_all(Root(), ec);
+    return Test::Result();
+}
@@ -0,0 +1,581 @@
+// FileEngine on disk: files from earlier releases converted on open, logs
+// damaged by a crash cut back to their last good record, compaction and
+// the blob store behind large payloads, each read back through every read
+// path.
+#include "TestCommon.h"
+#include "BlobStore.h"
+#include "FileEngine.h"
+#include "Hash.h"
+#include "Storage.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::filesystem::path Root() {
+    return std::filesystem::temp_directory_path() / "clippy2000_storage_test";
+}
+
+// An empty directory for one test, and the log path inside it
+std::wstring FreshLog(const char* name) {
+    std::filesystem::path dir = Root() / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return (dir / "history.db").wstring();
+}
+
+// A fresh log that starts out as a copy of a checked-in fixture
+std::wstring FixtureLog(const char* name, const char* fixture) {
+    std::wstring path = FreshLog(name);
+    std::filesystem::copy_file(std::filesystem::path(CLIPPY2000_FIXTURE_DIR) / fixture, std::filesystem::path(path));
+    return path;
+}
+
+std::chrono::system_clock::time_point Seconds(int64_t seconds) {
+    return std::chrono::system_clock::from_time_t(static_cast<std::time_t>(seconds));
+}
+
+std::chrono::system_clock::time_point Millis(int64_t ms) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(ms)));
+}
+
+bool Same(const ClipboardEntry& entry, const char* text, ClipboardDataType type) {
+    return entry.text == text && entry.type == type;
+}
+
+// Every entry oldest first, through ForEach
+std::vector<ClipboardEntry> ReadAll(StorageEngine& engine) {
+    std::vector<ClipboardEntry> entries;
+    engine.ForEach([&entries](const ClipboardEntry& entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    return entries;
+}
+
+std::string ReadBytes(const std::wstring& path, uint64_t offset, size_t size) {
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    std::string bytes(size, '\0');
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(&bytes[0], static_cast<std::streamsize>(size));
+    return bytes;
+}
+
+void WriteBytes(const std::wstring& path, uint64_t offset, const std::string& bytes) {
+    std::fstream file(std::filesystem::path(path), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void FlipByte(const std::wstring& path, uint64_t offset) {
+    std::string byte = ReadBytes(path, offset, 1);
+    byte[0] ^= 0x20;
+    WriteBytes(path, offset, byte);
+}
+
+uint64_t FileSize(const std::wstring& path) {
+    return std::filesystem::file_size(std::filesystem::path(path));
+}
+
+bool Exists(const std::wstring& path) {
+    return std::filesystem::exists(std::filesystem::path(path));
+}
+
+uint64_t GetU64(const std::string& bytes, size_t offset) {
+    uint64_t value = 0;
+    for (size_t i = 8; i-- > 0;) {
+        value = (value << 8) | static_cast<unsigned char>(bytes[offset + i]);
+    }
+    return value;
+}
+
+// The id a log's header and its sidecar index share
+uint64_t LogId(const std::wstring& path) {
+    return GetU64(ReadBytes(path, 0, 64), 16);
+}
+
+// "timestamp|type|text" lines with escaped newlines and pipes, lines that
+// cannot be parsed, CRLF endings and Latin-1 bytes, as the first release
+// wrote them
+void TestLegacyMigration() {
+    std::wstring path = FixtureLog("legacy", "legacy_history.txt");
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+
+        std::vector<ClipboardEntry> entries = ReadAll(engine);
+        CHECK(entries.size() == 7);
+        if (entries.size() == 7) {
+            CHECK(Same(entries[0], "first line\nsecond line", ClipboardDataType::Text));
+            CHECK(entries[0].timestamp == Seconds(1700000000));
+            CHECK(Same(entries[1], "a | pipe and a \\ backslash", ClipboardDataType::Text));
+            CHECK(entries[1].timestamp == Seconds(1700000060));
+
+            // An unreadable timestamp becomes the time of conversion
+            CHECK(Same(entries[2], "bad timestamp", ClipboardDataType::Text));
+            CHECK(entries[2].timestamp > Seconds(1700000300));
+
+            CHECK(Same(entries[3], "C:\\files\\a.txt;C:\\files\\b.txt", ClipboardDataType::Files));
+            CHECK(Same(entries[4], "bad type", ClipboardDataType::Text));
+
+            // The oldest lines had no type field
+            CHECK(Same(entries[5], "caf\xC3\xA9 cr\xC3\xA8me", ClipboardDataType::Text));
+            CHECK(entries[5].timestamp == Seconds(1700000240));
+            CHECK(Same(entries[6], "[Image]", ClipboardDataType::Image));
+        }
+
+        StorageStats stats = engine.GetStats();
+        CHECK(stats.entryCount == 7);
+        CHECK(stats.typeCounts[static_cast<size_t>(ClipboardDataType::Text)] == 5);
+        CHECK(stats.typeCounts[static_cast<size_t>(ClipboardDataType::Image)] == 1);
+        CHECK(stats.typeCounts[static_cast<size_t>(ClipboardDataType::Files)] == 1);
+
+        ClipboardEntry entry;
+        CHECK(engine.ReadAt(0, entry) && Same(entry, "[Image]", ClipboardDataType::Image));
+        CHECK(engine.ReadAt(6, entry) && Same(entry, "first line\nsecond line", ClipboardDataType::Text));
+    }
+
+    // Converted once; the second open reads the binary log
+    FileEngine engine(path);
+    CHECK(engine.Open());
+    std::vector<ClipboardEntry> latest = engine.LoadLatest(2);
+    CHECK(latest.size() == 2);
+    CHECK(latest.size() == 2 && Same(latest[0], "[Image]", ClipboardDataType::Image) &&
+          Same(latest[1], "caf\xC3\xA9 cr\xC3\xA8me", ClipboardDataType::Text));
+}
+
+// A version 1 log (records without a CRC) that ends in a torn record
+void TestUpgrade() {
+    std::wstring path = FixtureLog("upgrade", "history_v1.db");
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+
+        std::vector<ClipboardEntry> entries = ReadAll(engine);
+        CHECK(entries.size() == 4);
+        if (entries.size() == 4) {
+            CHECK(Same(entries[0], "plain text", ClipboardDataType::Text));
+            CHECK(entries[0].timestamp == Millis(1700000000000));
+            CHECK(Same(entries[1], "line one\nline two | caf\xC3\xA9 \xE6\x97\xA5\xE6\x9C\xAC", ClipboardDataType::Text));
+            CHECK(Same(entries[2], "C:\\a.txt;C:\\b.txt", ClipboardDataType::Files));
+            CHECK(Same(entries[3], "[Image]", ClipboardDataType::Image));
+            CHECK(entries[3].timestamp == Millis(1700000003000));
+        }
+        CHECK(engine.GetStats().entryCount == 4);
+
+        // The upgraded records take new appends after them
+        CHECK(engine.Append({ ClipboardEntry("after the upgrade") }, true));
+    }
+
+    FileEngine engine(path);
+    CHECK(engine.Open());
+    CHECK(engine.GetStats().entryCount == 5);
+    ClipboardEntry entry;
+    CHECK(engine.ReadAt(0, entry) && entry.text == "after the upgrade");
+    CHECK(engine.ReadAt(4, entry) && entry.text == "plain text");
+    size_t position = 0;
+    CHECK(engine.FindByTime(Millis(1700000001500), position) && position == 3);
+}
+
+// A log whose last records a crash left behind the header: the header's
+// counters cover the first batch only, and the later records are written
+// one at a time. ends[i] is the log size after record i of the later batch.
+std::wstring CrashedLog(const char* name, std::vector<uint64_t>& ends) {
+    std::wstring path = FreshLog(name);
+    std::string header;
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(engine.Append({ ClipboardEntry("kept 0"), ClipboardEntry("kept 1"), ClipboardEntry("kept 2") }, true));
+        header = ReadBytes(path, 0, 64);
+        for (int i = 0; i < 4; i++) {
+            CHECK(engine.Append({ ClipboardEntry("later " + std::to_string(i)) }, true));
+            ends.push_back(FileSize(path));
+        }
+    }
+    WriteBytes(path, 0, header);
+    return path;
+}
+
+// The entries a log holds newest first, checked against what every read
+// path returns
+void CheckSurvivors(const std::wstring& path, const std::vector<std::string>& expected) {
+    FileEngine engine(path);
+    CHECK(engine.Open());
+
+    // The recovered counters are recounted from the surviving records
+    StorageStats stats = engine.GetStats();
+    uint64_t payloadBytes = 0;
+    for (const auto& text : expected) {
+        payloadBytes += text.size();
+    }
+    CHECK(stats.entryCount == expected.size());
+    CHECK(stats.payloadBytes == payloadBytes);
+    CHECK(stats.typeCounts[static_cast<size_t>(ClipboardDataType::Text)] == expected.size());
+
+    std::vector<ClipboardEntry> latest = engine.LoadLatest(100);
+    CHECK(latest.size() == expected.size());
+    for (size_t i = 0; i < latest.size() && i < expected.size(); i++) {
+        CHECK(latest[i].text == expected[i]);
+        ClipboardEntry entry;
+        CHECK(engine.ReadAt(i, entry) && entry.text == expected[i]);
+    }
+    CHECK(ReadAll(engine).size() == expected.size());
+
+    // Appends continue where the log was cut
+    CHECK(engine.Append({ ClipboardEntry("after recovery") }, true));
+    ClipboardEntry entry;
+    CHECK(engine.ReadAt(0, entry) && entry.text == "after recovery");
+    CHECK(engine.ReadAt(expected.size(), entry) && entry.text == "kept 0");
+}
+
+void TestRecovery() {
+    // Torn: the last record is cut partway through
+    {
+        std::vector<uint64_t> ends;
+        std::wstring path = CrashedLog("torn", ends);
+        std::filesystem::resize_file(std::filesystem::path(path), ends[3] - 5);
+        {
+            FileEngine engine(path);
+            CHECK(engine.Open());
+            CHECK(FileSize(path) == ends[2]);
+        }
+        CheckSurvivors(path, { "later 2", "later 1", "later 0", "kept 2", "kept 1", "kept 0" });
+    }
+
+    // Damaged: a payload byte flipped in a record past the committed size,
+    // and the last record torn as well. The log is cut before the damage.
+    {
+        std::vector<uint64_t> ends;
+        std::wstring path = CrashedLog("damaged", ends);
+        FlipByte(path, ends[0] + 16 + 2);
+        std::filesystem::resize_file(std::filesystem::path(path), ends[3] - 5);
+        {
+            FileEngine engine(path);
+            CHECK(engine.Open());
+            CHECK(FileSize(path) == ends[0]);
+        }
+        CheckSurvivors(path, { "later 0", "kept 2", "kept 1", "kept 0" });
+    }
+
+    // The record the header's committed size ends on is damaged too, so the
+    // header cannot be trusted and the whole log is checked
+    {
+        std::vector<uint64_t> ends;
+        std::wstring path = CrashedLog("committed", ends);
+        uint64_t committed = GetU64(ReadBytes(path, 0, 64), 24);
+        FlipByte(path, committed - 9);
+        {
+            FileEngine engine(path);
+            CHECK(engine.Open());
+            CHECK(FileSize(path) < committed);
+        }
+        CheckSurvivors(path, { "kept 1", "kept 0" });
+    }
+}
+
+// "entry <i>" for i in [first, first + count), one second apart
+std::vector<ClipboardEntry> Entries(int first, int count) {
+    std::vector<ClipboardEntry> entries;
+    for (int i = first; i < first + count; i++) {
+        ClipboardEntry entry("entry " + std::to_string(i));
+        entry.timestamp = Millis(1700000000000 + i * 1000);
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+// A FileEngine that counts the calls Storage makes into it
+class CountingEngine : public FileEngine {
+public:
+    CountingEngine(const std::wstring& path, std::atomic<int>& appends, std::atomic<int>& compactions)
+        : FileEngine(path), m_appends(appends), m_compactions(compactions) {}
+
+    bool Append(const std::vector<ClipboardEntry>& batch, bool sync) override {
+        m_appends++;
+        return FileEngine::Append(batch, sync);
+    }
+
+    bool Compact(size_t retainEntries, double minSizeRatio) override {
+        bool compacted = FileEngine::Compact(retainEntries, minSizeRatio);
+        m_compactions++;
+        return compacted;
+    }
+
+private:
+    std::atomic<int>& m_appends;
+    std::atomic<int>& m_compactions;
+};
+
+// Compaction to K of N entries: written to a temp file and renamed over the
+// log under a new log id, with a sidecar index rebuilt to match
+void TestCompaction() {
+    std::wstring path = FreshLog("compaction");
+    uint64_t oldId = 0;
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        for (int i = 0; i < 50; i += 10) {
+            CHECK(engine.Append(Entries(i, 10), true));
+        }
+        oldId = LogId(path);
+
+        // Too small to be worth it unless forced, and nothing to drop
+        CHECK(!engine.Compact(20, 4.0));
+        CHECK(!engine.Compact(50, 0.0));
+        CHECK(LogId(path) == oldId);
+
+        CHECK(engine.Compact(20, 0.0));
+        CHECK(!Exists(path + L".compact") && !Exists(path + L".idx.compact"));
+        CHECK(engine.GetStats().entryCount == 20);
+
+        // Appends continue the compacted log
+        CHECK(engine.Append(Entries(50, 1), true));
+    }
+    CHECK(LogId(path) != oldId);
+
+    // Leftovers of a compaction interrupted before its rename
+    for (const wchar_t* suffix : { L".compact", L".idx.compact", L".blobs.compact", L".blobs.idx.compact" }) {
+        std::ofstream(std::filesystem::path(path + suffix), std::ios::binary) << "partial";
+    }
+
+    FileEngine engine(path);
+    CHECK(engine.Open());
+    for (const wchar_t* suffix : { L".compact", L".idx.compact", L".blobs.compact", L".blobs.idx.compact" }) {
+        CHECK(!Exists(path + suffix));
+    }
+
+    CHECK(engine.GetStats().entryCount == 21);
+    std::vector<ClipboardEntry> entries = ReadAll(engine);
+    CHECK(entries.size() == 21);
+    for (size_t i = 0; i < entries.size(); i++) {
+        CHECK(entries[i].text == "entry " + std::to_string(30 + i));
+    }
+    ClipboardEntry entry;
+    CHECK(engine.ReadAt(0, entry) && entry.text == "entry 50");
+    CHECK(engine.ReadAt(20, entry) && entry.text == "entry 30");
+    CHECK(!engine.ReadAt(21, entry));
+    size_t position = 0;
+    CHECK(engine.FindByTime(Millis(1700000040500), position) && position == 10);
+
+    // The sidecar carries the new log id and one entry per record, oldest
+    // first, pointing at the record with that entry's timestamp
+    std::wstring indexPath = path + L".idx";
+    CHECK(FileSize(indexPath) == 16 + 21 * 16);
+    std::string index = ReadBytes(indexPath, 0, static_cast<size_t>(FileSize(indexPath)));
+    CHECK(index.compare(0, 4, "CLPI") == 0);
+    CHECK(GetU64(index, 8) == LogId(path));
+    uint64_t lastOffset = 0;
+    for (size_t i = 0; i < 21 && index.size() == 16 + 21 * 16; i++) {
+        uint64_t offset = GetU64(index, 16 + i * 16);
+        CHECK(offset >= 64 && offset > lastOffset && offset < FileSize(path));
+        CHECK(static_cast<int64_t>(GetU64(index, 16 + i * 16 + 8)) == 1700000000000 + (30 + static_cast<int64_t>(i)) * 1000);
+        lastOffset = offset;
+    }
+}
+
+// A compaction the engine skips leaves Storage's version and epoch where
+// they were; one that runs moves both
+void TestStorageCompaction() {
+    std::wstring path = FreshLog("storage_compaction");
+    std::atomic<int> appends(0);
+    std::atomic<int> compactions(0);
+
+    auto waitForCompaction = [&compactions](int count) {
+        for (int i = 0; i < 1000 && compactions < count; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return compactions >= count;
+    };
+
+    {
+        Storage storage(std::make_unique<CountingEngine>(path, appends, compactions));
+        storage.SetCompactionPolicy(100);
+        CHECK(storage.Initialize());
+        for (const auto& entry : Entries(0, 10)) {
+            CHECK(storage.SaveEntry(entry));
+        }
+        storage.Flush();
+
+        // Fewer entries than retained: a forced compaction has nothing to do
+        int before = compactions;
+        storage.RequestCompaction();
+        CHECK(waitForCompaction(before + 1));
+        storage.Shutdown();
+
+        CHECK(storage.GetCount() == 10);
+        CHECK(storage.GetEpoch() == 0);
+        CHECK(storage.GetVersion() == 2 * static_cast<uint64_t>(appends));
+    }
+
+    appends = 0;
+    compactions = 0;
+    Storage storage(std::make_unique<CountingEngine>(path, appends, compactions));
+    storage.SetCompactionPolicy(4);
+    CHECK(storage.Initialize());
+    storage.RequestCompaction();
+    CHECK(waitForCompaction(1));
+    storage.Shutdown();
+
+    CHECK(storage.GetCount() == 4);
+    CHECK(storage.GetEpoch() == 1);
+    CHECK(storage.GetVersion() == 2);
+}
+
+ClipboardEntry TimedEntry(const std::string& text, int64_t ms) {
+    ClipboardEntry entry(text);
+    entry.timestamp = Millis(ms);
+    return entry;
+}
+
+// Whether the blob store next to a closed log still holds text
+bool BlobStored(const std::wstring& path, const std::string& text) {
+    BlobStore blobs;
+    std::string data;
+    return blobs.Open(path + L".blobs") && blobs.Read(Hash::XXH64(text.data(), text.size()), data) && data == text;
+}
+
+// Payloads of 64 bytes or more are stored once in the blob store and
+// referenced from every record that holds them, until compaction drops the
+// last of those records
+void TestBlobs() {
+    const std::string shared(100, 'a');
+    const std::string other(200, 'b');
+    const std::string inlined(63, 'c');
+    const std::string smallest(64, 'd');
+
+    std::wstring path = FreshLog("blobs");
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(engine.Append({ TimedEntry(shared, 1000) }, true));
+        uint64_t blobBytes = FileSize(path + L".blobs");
+        CHECK(engine.Append({ TimedEntry(shared, 2000), TimedEntry(inlined, 3000) }, true));
+        CHECK(FileSize(path + L".blobs") == blobBytes);
+        CHECK(engine.Append({ TimedEntry(smallest, 4000), TimedEntry(other, 5000) }, true));
+        CHECK(FileSize(path + L".blobs") > blobBytes);
+
+        // Blob-backed text is read on demand; inline text comes with the entry
+        ClipboardEntry entry;
+        CHECK(engine.ReadAt(0, entry) && entry.stored && entry.text.empty() && entry.TextSize() == 200);
+        CHECK(entry.LoadText() && entry.text == other && !entry.stored);
+        CHECK(engine.ReadAt(1, entry) && entry.stored && entry.LoadText() && entry.text == smallest);
+        CHECK(engine.ReadAt(2, entry) && !entry.stored && entry.text == inlined);
+        CHECK(engine.ReadAt(3, entry) && entry.stored && entry.LoadText() && entry.text == shared);
+        CHECK(engine.ReadAt(4, entry) && entry.stored && entry.LoadText() && entry.text == shared);
+
+        // The blob outlives the first of its two records
+        CHECK(engine.Compact(4, 0.0));
+        CHECK(engine.ReadAt(3, entry) && entry.LoadText() && entry.text == shared);
+    }
+    CHECK(BlobStored(path, shared));
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        ClipboardEntry entry;
+        CHECK(engine.ReadAt(3, entry) && entry.LoadText() && entry.text == shared);
+
+        // and goes with the last one
+        CHECK(engine.Compact(3, 0.0));
+        std::vector<ClipboardEntry> entries = ReadAll(engine);
+        CHECK(entries.size() == 3);
+        for (auto& kept : entries) {
+            CHECK(kept.LoadText());
+        }
+        CHECK(entries.size() == 3 && entries[0].text == inlined && entries[1].text == smallest &&
+              entries[2].text == other);
+    }
+    CHECK(!BlobStored(path, shared));
+    CHECK(BlobStored(path, other) && BlobStored(path, smallest));
+
+    // A torn blob record at the end of the store is cut off on open, and
+    // the blobs before it stay readable
+    uint64_t blobBytes = FileSize(path + L".blobs");
+    // Hash, then stored and raw sizes of 4096, then a few of those bytes
+    std::string torn(8, '\x5A');
+    torn += std::string("\x00\x10\x00\x00\x00\x10\x00\x00", 8) + "partial";
+    WriteBytes(path + L".blobs", blobBytes, torn);
+    CHECK(FileSize(path + L".blobs") == blobBytes + torn.size());
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(FileSize(path + L".blobs") == blobBytes);
+        ClipboardEntry entry;
+        CHECK(engine.ReadAt(0, entry) && entry.LoadText() && entry.text == other);
+    }
+
+    // A store whose header is damaged is started over: its texts are lost,
+    // the records and their inline texts are not
+    FlipByte(path + L".blobs", 0);
+    FileEngine engine(path);
+    CHECK(engine.Open());
+    CHECK(engine.GetStats().entryCount == 3);
+    ClipboardEntry entry;
+    CHECK(engine.ReadAt(0, entry) && entry.stored && !entry.LoadText() && entry.text.empty());
+    CHECK(engine.ReadAt(2, entry) && entry.text == inlined);
+
+    // New payloads go to the fresh store
+    CHECK(engine.Append({ TimedEntry(shared, 6000) }, true));
+    CHECK(engine.ReadAt(0, entry) && entry.LoadText() && entry.text == shared);
+}
+
+bool SameStats(const StorageStats& stats, uint64_t entries, uint64_t payloadBytes, uint64_t texts, uint64_t images,
+               uint64_t files) {
+    return stats.entryCount == entries && stats.payloadBytes == payloadBytes &&
+           stats.typeCounts[static_cast<size_t>(ClipboardDataType::Text)] == texts &&
+           stats.typeCounts[static_cast<size_t>(ClipboardDataType::Image)] == images &&
+           stats.typeCounts[static_cast<size_t>(ClipboardDataType::Files)] == files;
+}
+
+// The counters kept in the log header through append, reopen, compaction
+// and clear. A blob-backed entry counts its 12-byte reference.
+void TestStats() {
+    std::wstring path = FreshLog("stats");
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(SameStats(engine.GetStats(), 0, 0, 0, 0, 0));
+        CHECK(engine.Append({ TimedEntry("one", 1000), ClipboardEntry("C:\\a.txt", ClipboardDataType::Files) }, true));
+        CHECK(SameStats(engine.GetStats(), 2, 3 + 8, 1, 0, 1));
+        CHECK(engine.Append({ ClipboardEntry("[Image]", ClipboardDataType::Image), TimedEntry(std::string(100, 'x'), 2000) },
+                            true));
+        CHECK(SameStats(engine.GetStats(), 4, 3 + 8 + 7 + 12, 2, 1, 1));
+    }
+    {
+        FileEngine engine(path);
+        CHECK(engine.Open());
+        CHECK(SameStats(engine.GetStats(), 4, 3 + 8 + 7 + 12, 2, 1, 1));
+
+        CHECK(engine.Compact(2, 0.0));
+        CHECK(SameStats(engine.GetStats(), 2, 7 + 12, 1, 1, 0));
+    }
+
+    FileEngine engine(path);
+    CHECK(engine.Open());
+    CHECK(SameStats(engine.GetStats(), 2, 7 + 12, 1, 1, 0));
+    CHECK(engine.Clear());
+    CHECK(SameStats(engine.GetStats(), 0, 0, 0, 0, 0));
+    CHECK(engine.Append({ TimedEntry("two", 3000) }, true));
+    CHECK(SameStats(engine.GetStats(), 1, 3, 1, 0, 0));
+}
+
+} // namespace
+
+int main() {
+    TestLegacyMigration();
+    TestUpgrade();
+    TestRecovery();
+    TestCompaction();
+    TestStorageCompaction();
+    TestBlobs();
+    TestStats();
+
+    std::error_code ec;
+    std::filesystem::remove_all(Root(), ec);
+    return Test::Result();
+}
@@ -0,0 +1,148 @@
+// Substring search: every TextSearch method this build and CPU support must
+// agree with std::string_view::find, including short needles, haystacks
+// shorter than one vector, matches at the block edges, and needles whose
+// rarest byte is common in the text.
+#include "TestCommon.h"
+#include "TextSearch.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+const TextSearch::Method kMethods[] = { TextSearch::Method::Scalar, TextSearch::Method::Sse2, TextSearch::Method::Avx2 };
+
+uint64_t Next(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+// Compare one search against the scalar matcher. The haystack is copied
+// into a buffer of exactly its size so an overread lands outside it.
+void CheckFind(std::string_view text, std::string_view needle) {
+    std::unique_ptr<char[]> copy(new char[text.size() + 1]);
+    std::copy(text.begin(), text.end(), copy.get());
+    std::string_view exact(copy.get(), text.size());
+
+    size_t expected = text.find(needle);
+    for (TextSearch::Method method : kMethods) {
+        if (TextSearch::IsSupported(method)) {
+            CHECK(TextSearch::FindWith(method, exact, needle) == expected);
+        }
+    }
+    CHECK(TextSearch::Find(exact, needle) == expected);
+    CHECK(TextSearch::Pattern(needle).Find(exact) == expected);
+    CHECK(TextSearch::Contains(exact, needle) == (expected != std::string_view::npos));
+}
+
+void TestFixed() {
+    CheckFind("", "");
+    CheckFind("", "a");
+    CheckFind("a", "");
+    CheckFind("a", "a");
+    CheckFind("a", "ab");
+    CheckFind("ab", "ab");
+    CheckFind("ba", "ab");
+    CheckFind("hello world", "o");
+    CheckFind("hello world", "ld");
+    CheckFind("hello world", "he");
+    CheckFind("hello world", "world!");
+
+    // Bytes above 0x7F and embedded NULs compare as plain bytes
+    CheckFind(std::string_view("a\0b\0c", 5), std::string_view("\0c", 2));
+    CheckFind("caf\xC3\xA9 cr\xC3\xA8me", "\xC3\xA8");
+    CheckFind("\xFF\xFE\xFF\xFF", "\xFF\xFF");
+}
+
+// A single match at every offset of haystacks around one and two vector
+// widths, with needles of every length up to just past a vector
+void TestEveryOffset() {
+    for (size_t length = 1; length <= 70; length++) {
+        for (size_t needleLength = 1; needleLength <= 34 && needleLength <= length; needleLength++) {
+            std::string needle(needleLength, 'b');
+            needle.front() = 'x';
+            needle.back() = 'y';
+            for (size_t at = 0; at + needleLength <= length; at++) {
+                std::string text(length, 'b');
+                text.replace(at, needleLength, needle);
+                CheckFind(text, needle);
+
+                // Only the first or last byte matches
+                std::string firstOnly = text;
+                firstOnly[at + needleLength - 1] = 'z';
+                CheckFind(firstOnly, needle);
+                std::string lastOnly = text;
+                lastOnly[at] = 'z';
+                CheckFind(lastOnly, needle);
+            }
+            CheckFind(std::string(length, 'b'), needle);
+        }
+    }
+}
+
+// Small alphabets, so candidates and partial matches are frequent
+void TestRandom() {
+    uint64_t state = 3;
+    for (int i = 0; i < 40000; i++) {
+        size_t alphabet = 2 + Next(state) % 3;
+        size_t length = Next(state) % 100;
+        std::string text;
+        for (size_t j = 0; j < length; j++) {
+            text.push_back(static_cast<char>('a' + Next(state) % alphabet));
+        }
+
+        size_t needleLength = 1 + Next(state) % 8;
+        std::string needle;
+        if (length >= needleLength && Next(state) % 2 == 0) {
+            needle = text.substr(Next(state) % (length - needleLength + 1), needleLength);
+        } else {
+            for (size_t j = 0; j < needleLength; j++) {
+                needle.push_back(static_cast<char>('a' + Next(state) % alphabet));
+            }
+        }
+        CheckFind(text, needle);
+    }
+}
+
+// Find first skips between occurrences of the needle's rarest byte, and
+// hands over to the vector filters once they come close together: matches
+// before, at and after that point, with the rare byte at either end or
+// inside the needle
+void TestRareByte() {
+    for (const char* needle : { "zab", "abz", "azb", "zz" }) {
+        for (size_t spacing : { 1, 3, 40, 200 }) {
+            std::string text;
+            for (size_t i = 0; text.size() < 3000; i++) {
+                text.append(spacing, 'a');
+                text.push_back(i % 2 == 0 ? 'z' : 'b');
+            }
+            CheckFind(text, needle);
+            for (size_t at : { 0, 5, 63, 64, 200, 511, 512, 1000, 2990 }) {
+                std::string placed = text;
+                placed.replace(at, std::string_view(needle).size(), needle);
+                CheckFind(placed, needle);
+            }
+        }
+    }
+
+    // Sparse at first, then dense
+    std::string text = std::string(2000, 'a') + "z" + std::string(1000, 'a');
+    for (size_t i = 0; i < 100; i++) {
+        text += "zaz";
+    }
+    CheckFind(text, "zab");
+    CheckFind(text + "zab", "zab");
+}
+
+} // namespace
+
+int main() {
+    TestFixed();
+    TestEveryOffset();
+    TestRandom();
+    TestRareByte();
+    return Test::Result();
+}